@@ -0,0 +1,204 @@
+//
+//  Buffer.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_Buffer_h
+#define Set_Buffer_h
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace set { namespace utils {
+    
+    /**
+     Minimum size in bytes of the buffers mapped with huge pages, 0 to keep them
+     disabled, the default. Only the buffers of trivially copyable types are mapped.
+     */
+    inline std::atomic<size_t> large_pages{0};
+    
+    /**
+     Class that implement a resizable array, allocated with new or, when large pages
+     are enabled and the array is big enough, mapped with huge pages: explicit 2 MB
+     pages if the system has them reserved, transparent huge pages requested with
+     madvise otherwise, so that the random probes into large tables miss the TLB less.
+     A mapped buffer is resized with mremap, that moves the pages instead of copying
+     the elements, and falls back to the regular allocation if mapping fails.
+     The elements are default initialized.
+     
+     @param T the type of the elements
+     */
+    template <typename T>
+    class Buffer {
+        
+        static constexpr size_t PAGE = size_t(2) << 20;
+    
+    public:
+        Buffer() =default;
+        
+        /**
+         Constructor, allocates n elements.
+         @param n the number of elements
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        explicit Buffer(size_t n) {
+            allocate(n);
+        }
+        
+        /**
+         Move constructor, steals the memory of the other Buffer.
+         @param other the buffer to move
+         */
+        Buffer(Buffer&& other) noexcept: data(other.data), count(other.count), length(other.length) {
+            other.data = nullptr;
+            other.count = other.length = 0;
+        }
+        
+        /**
+         Move assignment, releases the memory and steals the one of the other Buffer.
+         @param other the buffer to move
+         @returns reference to this Buffer
+         */
+        Buffer& operator=(Buffer&& other) noexcept {
+            if (this != &other) {
+                reset();
+                
+                std::swap(data, other.data);
+                std::swap(count, other.count);
+                std::swap(length, other.length);
+            }
+            
+            return *this;
+        }
+        
+        ~Buffer() {
+            reset();
+        }
+        
+        T* get() const {
+            return data;
+        }
+        
+        T& operator[](size_t i) const {
+            return data[i];
+        }
+        
+        size_t size() const {
+            return count;
+        }
+        
+        /**
+         Check if the buffer is mapped with mmap.
+         @returns true if mapped
+         */
+        bool mapped() const {
+            return length != 0;
+        }
+        
+        /**
+         Resize the buffer to n elements, keeping the first used ones, the others are
+         default initialized. A mapped buffer is remapped in place or moved by the kernel,
+         the other ones are allocated again and the elements kept are moved.
+         @param n the new number of elements
+         @param used the number of elements to keep
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void resize(size_t n, size_t used) {
+            used = std::min(used, std::min(n, count));
+
+#ifdef __linux__
+            if (mapped()) {
+                auto len = round(n);
+                auto p = len == length ? data : mremap(data, length, len, MREMAP_MAYMOVE);
+                
+                if (p != MAP_FAILED) {
+                    data = static_cast<T*>(p);
+                    length = len;
+                    count = n;
+                    
+                    std::uninitialized_default_construct(data+used, data+n);
+                    return;
+                }
+            }
+#endif
+            
+            Buffer other(n);
+            std::move(data, data+used, other.data);
+            
+            *this = std::move(other);
+        }
+        
+        /**
+         Release the memory.
+         */
+        void reset() {
+#ifdef __linux__
+            if (mapped()) munmap(data, length);
+            else
+#endif
+            delete[] data;
+            
+            data = nullptr;
+            count = length = 0;
+        }
+    
+    private:
+        /**
+         Allocate n elements, mapping them if large pages are enabled and they're enough.
+         @param n the number of elements
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void allocate(size_t n) {
+            count = n;
+
+#ifdef __linux__
+            auto threshold = large_pages.load(std::memory_order_relaxed);
+            
+            if (std::is_trivially_copyable<T>::value && threshold && n * sizeof(T) >= threshold) {
+                auto len = round(n);
+                auto p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                
+                if (p == MAP_FAILED) {
+                    p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    if (p != MAP_FAILED) madvise(p, len, MADV_HUGEPAGE);
+                }
+                
+                if (p != MAP_FAILED) {
+                    data = static_cast<T*>(p);
+                    length = len;
+                    
+                    std::uninitialized_default_construct(data, data+n);
+                    return;
+                }
+            }
+#endif
+            
+            data = new T[n];
+        }
+        
+        /**
+         Size in bytes of the mapping of n elements, a multiple of the huge page size.
+         @param n the number of elements
+         @returns the size of the mapping
+         */
+        static size_t round(size_t n) {
+            return std::max<size_t>(1, (n * sizeof(T) + PAGE - 1) / PAGE) * PAGE;
+        }
+        
+        T* data = nullptr;
+        size_t count = 0;
+        size_t length = 0;
+    };
+
+} }
+
+#endif
@@ -0,0 +1,333 @@
+//
+//  CompactSet.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_CompactSet_h
+#define Set_CompactSet_h
+
+#include <vector>
+#include <iterator>
+
+#include "Set.h"
+#include "Roaring.h"
+
+namespace set {
+    
+    /**
+     Class that implement a Set-like structure of integers, ordered by insertion, that
+     stores the elements bit-packed with frame of reference: every block of BLOCK elements
+     keeps its minimum and the differences from it in the minimal number of bits, so
+     20-30 bit values take about half of a 64-bit slot.
+     All the elements of a block have the same width, so operator[] extracts an element
+     in O(1) from at most two words, the iteration decodes a whole block at time with a
+     branch-free loop that the compiler can vectorize.
+     The last elements are kept unpacked until they fill a block.
+     The default filter is exact, so the blocks are decoded only by an approximate
+     filter that answers MAYBE, but it takes a few bytes per element on sparse values,
+     and bytes() counts them too.
+     
+     @param T the type of the values inside the Set, must be integral
+     @param F the filter to use
+     @param Hash the hash function, the filter should use the same
+     @param KeyEqual the equality used to compare the elements
+     */
+    template <typename T,
+              typename F = RoaringFilter<T>,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>>
+    class CompactSet {
+        
+        static_assert(std::is_integral<T>::value, "CompactSet needs an integral type");
+        
+        using U = typename std::make_unsigned<T>::type;
+        
+        static constexpr size_t BLOCK = 64;
+        static constexpr unsigned BITS = sizeof(T) * 8;
+        
+        /**
+         Struct that rappresent a block, the elements are stored as width bits
+         differences from base, in width words starting at offset.
+         */
+        struct Block {
+            T base;
+            uint8_t width;
+            size_t offset;
+        };
+        
+        /**
+         Iterator that decodes a block at time
+         */
+        class _iterator {
+        
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = T;
+            using difference_type   = ptrdiff_t;
+            using pointer           = const T*;
+            using reference         = T;
+            
+            /**
+             Dereference operator
+             @returns the current value
+             */
+            T operator*() const {
+                return p < s->packed() ? buffer[p % BLOCK] : s->tail[p - s->packed()];
+            }
+            
+            /**
+             Pre-increment operator;
+             @returns _iterator incremented;
+             */
+            _iterator& operator++() {
+                if (++p % BLOCK == 0) load();
+                return *this;
+            }
+            
+            /**
+             Post-increment operator;
+             @returns _iterator not incremented;
+             */
+            _iterator operator++(int) {
+                auto it = *this;
+                ++*this;
+                
+                return it;
+            }
+            
+            bool operator==(const _iterator& other) const {
+                return p == other.p && s == other.s;
+            }
+            
+            bool operator!=(const _iterator& other) const {
+                return !(*this == other);
+            }
+        
+        private:
+            const CompactSet* s;
+            size_t p;
+            T buffer[BLOCK];
+            
+            friend class CompactSet;
+            
+            _iterator(const CompactSet* s_, size_t p_): s(s_), p(p_) {
+                load();
+            }
+            
+            void load() {
+                if (p < s->packed()) s->decode(p / BLOCK, buffer);
+            }
+        };
+    
+    public:
+        using const_iterator = _iterator;
+        
+        CompactSet() =default;
+        
+        /**
+         Constructor from generic iterators, the filter is presized for all
+         the elements and the duplicates are skipped.
+         @param begin first element of the iterator
+         @param end last element of the iterator
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        CompactSet(Iterator begin, Iterator end) {
+            filters::reserve(filter, end - begin);
+            
+            for (; begin != end; begin++)
+                try {
+                    insert(*begin);
+                } catch (exceptions::already_in) {
+                
+                }
+        }
+        
+        /**
+         Subscribe operator to access element by index in costant time, extracting
+         it from its block.
+         @param p the index of the element to retrieve
+         @returns the element
+         */
+        T operator[](size_t p) const {
+            if (p >= packed()) return tail[p - packed()];
+            
+            auto& block = blocks[p / BLOCK];
+            auto bit = (p % BLOCK) * block.width;
+            
+            return T(U(block.base) + extract(bits.data() + block.offset + bit / 64, bit % 64, block.width));
+        }
+        
+        /**
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        size_t size() const {
+            return packed() + tail.size();
+        }
+        
+        /**
+         Memory used by the elements, the blocks, the tail and the filter.
+         @returns the size in bytes
+         */
+        size_t bytes() const {
+            return blocks.size() * sizeof(Block) + bits.size() * sizeof(uint64_t) + tail.capacity() * sizeof(T) +
+                   filters::bytes(filter);
+        }
+        
+        /**
+         Insert an element into the Set, the filter is queried first and the blocks
+         are scanned only if it returns MAYBE. When the unpacked elements fill a
+         block they are packed.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        void insert(T t) {
+            auto query = filter.query(t);
+            
+            if (query == Query::FOUND || (query == Query::MAYBE && contains(t)))
+                throw exceptions::already_in();
+            
+            filter.add(t);
+            tail.push_back(t);
+            
+            if (tail.size() == BLOCK) pack();
+        }
+        
+        /**
+         Check if an element is in the Set, the filter is queried first and the
+         blocks that can contain the element are decoded only if it returns MAYBE.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        template <typename V>
+        bool contains(const V& t) const {
+            auto query = filter.query(t);
+            if (query != Query::MAYBE) return query == Query::FOUND;
+            
+            T buffer[BLOCK];
+            
+            for (size_t b=0; b < blocks.size(); b++) {
+                auto delta = U(U(t) - U(blocks[b].base));
+                if (blocks[b].width < BITS && delta >> blocks[b].width) continue;
+                
+                decode(b, buffer);
+                if (find_linear(buffer, BLOCK, t, equal) != -1) return true;
+            }
+            
+            return find_linear(tail.data(), int(tail.size()), t, equal) != -1;
+        }
+        
+        /**
+         Return the const_iterator, pointing at the first element
+         @returns the const_iterator
+         */
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        
+        /**
+         Return the const_iterator, pointing at the element after the last
+         @returns the const_iterator
+         */
+        const_iterator end() const {
+            return const_iterator(this, size());
+        }
+    
+    private:
+        /**
+         Number of elements packed in blocks
+         @returns the number of elements
+         */
+        size_t packed() const {
+            return blocks.size() * BLOCK;
+        }
+        
+        /**
+         Read width bits starting at bit s of the word w, the words are padded so
+         the next one can always be read, even by the blocks of width 0.
+         @param w pointer to the word
+         @param s the first bit inside the word
+         @param width the number of bits
+         @returns the value
+         */
+        static U extract(const uint64_t* w, unsigned s, unsigned width) {
+            auto mask = width >= 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+            
+            return U(((w[0] >> s) | ((w[1] << 1) << (63 - s))) & mask);
+        }
+        
+        /**
+         Decode all the elements of a block, without branches in the loop.
+         @param b the block
+         @param out where to write the BLOCK elements
+         */
+        void decode(size_t b, T* out) const {
+            auto& block = blocks[b];
+            const uint64_t* w = bits.data() + block.offset;
+            
+            for (size_t i=0; i < BLOCK; i++) {
+                auto bit = unsigned(i * block.width);
+                out[i] = T(U(block.base) + extract(w + bit / 64, bit % 64, block.width));
+            }
+        }
+        
+        /**
+         Pack the tail in a new block, with the minimal width for the differences
+         from the minimum.
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void pack() {
+            auto base = *std::min_element(tail.begin(), tail.end());
+            
+            U max = 0;
+            for (auto t: tail)
+                max = std::max(max, U(U(t) - U(base)));
+            
+            auto width = static_cast<uint8_t>(max ? 64 - __builtin_clzll(uint64_t(max)) : 0);
+            
+            if (bits.empty()) bits.resize(2);
+            
+            // the last two words are the padding read by extract
+            auto offset = bits.size() - 2;
+            bits.resize(bits.size() + width);
+            
+            for (size_t i=0; i < BLOCK; i++) {
+                uint64_t d = U(U(tail[i]) - U(base));
+                auto bit = i * width;
+                auto s = bit % 64;
+                
+                bits[offset + bit / 64] |= d << s;
+                if (s && s + width > 64) bits[offset + bit / 64 + 1] |= d >> (64 - s);
+            }
+            
+            blocks.push_back({base, width, offset});
+            tail.clear();
+        }
+        
+        /**
+         Comodity function to easily display the content of a Set.
+         @param os stream to write on
+         @param set reference of the set to write
+         @return output stream
+         */
+        friend std::ostream& operator<<(std::ostream &os, const CompactSet &set) {
+            for (auto e: set) {
+                os << e << " ";
+            }
+            
+            return os;
+        }
+        
+        std::vector<Block> blocks;
+        std::vector<uint64_t> bits;
+        std::vector<T> tail;
+        
+        mutable F filter;
+        KeyEqual equal;
+    };
+}
+
+#endif
@@ -0,0 +1,276 @@
+//
+//  CuckooMap.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_CuckooMap_h
+#define Set_CuckooMap_h
+
+#include <array>
+#include <random>
+#include <vector>
+
+#include "Utils.h"
+#include "Buffer.h"
+
+namespace set {
+    
+    using namespace utils;
+    
+    /**
+     Class that implement a key-value map based on Cuckoo Hashing, with the same machinery
+     of CuckooTable: K hash functions, the kicks, a stash for the keys that can't be placed
+     and the rebuild with a new seed and twice the capacity when the stash is full.
+     The keys are stored in their own array and the values in a parallel one, at the same
+     position, so the probes touch only the compact array of the keys and a value is read
+     only once its key is found.
+     
+     @param Key the type of the keys
+     @param V the type of the values
+     @param SIZE the initial size of the table
+     @param K the number of hash functions
+     @param STASH_SIZE the size of the stash
+     @param MAX_DEPTH the depth cutoff
+     @param Hash the hash function
+     @param KeyEqual the equality
+     */
+    template <typename Key,
+              typename V,
+              size_t SIZE = 1000,
+              size_t K = 2,
+              size_t STASH_SIZE = 2,
+              size_t MAX_DEPTH = 100,
+              typename Hash = hasher<Key>,
+              typename KeyEqual = std::equal_to<>>
+    class CuckooMap {
+        
+        /**
+         Simple struct to rappresent each slot of the keys.
+         */
+        struct Nest {
+            Key key;
+            uint full : 1;
+            
+            Nest(): key(Key()), full(0) {};
+        };
+        
+        static constexpr size_t NONE = size_t(-1);
+    
+    public:
+        /**
+         Constructor, the seed selects the hash functions and the sequence of the kicks.
+         @param seed_ the seed
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        CuckooMap(size_t seed_ = 0): seed(seed_), random(seed_), keys(SIZE), values(SIZE) {}
+        
+        /**
+         Number of keys in the map
+         @returns the number of keys
+         */
+        size_t size() const {
+            return count;
+        }
+        
+        /**
+         Search the key in its K nests and in the stash.
+         @param key the key
+         @returns pointer to the value, nullptr if the key isn't in the map
+         */
+        template <typename U>
+        V* find(const U& key) {
+            auto p = slot(key);
+            if (p == NONE) return nullptr;
+            
+            return p < capacity ? &values[p] : &stash[p - capacity].second;
+        }
+        
+        template <typename U>
+        const V* find(const U& key) const {
+            return const_cast<CuckooMap*>(this)->find(key);
+        }
+        
+        /**
+         Check if the key is in the map.
+         @param key the key
+         @returns true if found
+         */
+        template <typename U>
+        bool contains(const U& key) const {
+            return slot(key) != NONE;
+        }
+        
+        /**
+         Insert the key with the value, or assign the value if the key is already in
+         the map. A new key is placed like CuckooTable::add, kicking the keys in its
+         way together with their values.
+         @param key the key
+         @param v the value
+         @returns true if the key was inserted, false if assigned
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename W>
+        bool insert_or_assign(const Key& key, W&& v) {
+            auto p = slot(key);
+            
+            if (p != NONE) {
+                (p < capacity ? values[p] : stash[p - capacity].second) = std::forward<W>(v);
+                return false;
+            }
+            
+            place(key, V(std::forward<W>(v)));
+            count++;
+            
+            return true;
+        }
+        
+        /**
+         Remove the key and its value from the map.
+         @param key the key
+         @returns true if the key was in the map
+         */
+        template <typename U>
+        bool erase(const U& key) {
+            auto p = slot(key);
+            if (p == NONE) return false;
+            
+            if (p < capacity) {
+                keys[p] = Nest();
+                values[p] = V();
+            } else {
+                stash[p - capacity] = std::move(stash[--stash_use]);
+                stash[stash_use] = {};
+            }
+            
+            count--;
+            return true;
+        }
+        
+        /**
+         Make room for n keys, rehashing them in a larger table if the load
+         would be above one half.
+         @param n the number of keys expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve(size_t n) {
+            if (2*n > capacity) rebuild(seed, 2*n);
+        }
+    
+    private:
+        /**
+         Find the position of the key, the positions from capacity on are in the stash.
+         @param key the key
+         @returns the position, NONE if not found
+         */
+        template <typename U>
+        size_t slot(const U& key) const {
+            auto p = hash_pair(key, seed, hashfn);
+            
+            for (int k=0; k < K; k++) {
+                auto h = (p.first + k*p.second) % capacity;
+                
+                if (keys[h].full && equal(keys[h].key, key)) return h;
+            }
+            
+            for (int i=0; i < stash_use; i++)
+                if (equal(stash[i].first, key)) return capacity + i;
+            
+            return NONE;
+        }
+        
+        /**
+         Place a key that isn't in the map in one of its free nests, if they're all
+         full kick the key of a random one, other than the nest the key was just
+         kicked from, and place that key, see CuckooTable::add.
+         @param key the key
+         @param v the value
+         @param from the nest the key was kicked from
+         @param depth the depth cutoff for the recursion
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void place(Key key, V v, size_t from=NONE, int depth=0) {
+            auto p = hash_pair(key, seed, hashfn);
+            
+            for (int k=0; k < K; k++) {
+                auto h = (p.first + k*p.second) % capacity;
+                
+                if (!keys[h].full) {
+                    keys[h].key = std::move(key);
+                    keys[h].full = 1;
+                    values[h] = std::move(v);
+                    
+                    return;
+                }
+            }
+            
+            auto k = random() % K;
+            auto index = (p.first + k*p.second) % capacity;
+            
+            if (index == from)
+                index = (p.first + (k+1) % K * p.second) % capacity;
+            
+            if (depth == MAX_DEPTH) {
+                if (stash_use < STASH_SIZE)
+                    stash[stash_use++] = {std::move(key), std::move(v)};
+                
+                else {
+                    rebuild(index);
+                    place(std::move(key), std::move(v));
+                }
+                
+                return;
+            }
+            
+            std::swap(keys[index].key, key);
+            std::swap(values[index], v);
+            
+            place(std::move(key), std::move(v), index, ++depth);
+        }
+        
+        /**
+         Rebuilds the table with a new seed and a larger capacity, the keys and the values
+         are set aside and placed again, the arrays are resized in place.
+         @param seed_ the new seed
+         @param capacity_ the new capacity, twice the current one if 0
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void rebuild(size_t seed_, size_t capacity_ = 0) {
+            std::vector<std::pair<Key, V>> old;
+            
+            for (size_t i=0; i < capacity; i++)
+                if (keys[i].full)
+                    old.emplace_back(std::move(keys[i].key), std::move(values[i]));
+            
+            for (int i=0; i < stash_use; i++)
+                old.push_back(std::move(stash[i]));
+            
+            capacity = capacity_ ? capacity_ : 2*capacity;
+            stash_use = 0;
+            seed = seed_;
+            keys.resize(capacity, 0);
+            values.resize(capacity, 0);
+            stash = {};
+            
+            for (auto& e: old)
+                place(std::move(e.first), std::move(e.second));
+        }
+        
+        size_t seed;
+        size_t capacity = SIZE;
+        size_t count = 0;
+        int stash_use = 0;
+        
+        std::minstd_rand random;
+        
+        Hash hashfn;
+        KeyEqual equal;
+        
+        Buffer<Nest> keys;
+        Buffer<V> values;
+        std::array<std::pair<Key, V>, STASH_SIZE> stash;
+    };
+}
+
+#endif
@@ -29,6 +29,15 @@ namespace set { namespace exceptions {
     struct not_found: public std::runtime_error {
         not_found(): std::runtime_error("Element not found") {}
     };
+    
+    
+    /**
+     Custom exception thrown in the case one tries to merge two filters
+     built with different seeds or sizes.
+     */
+    struct incompatible: public std::runtime_error {
+        incompatible(): std::runtime_error("Incompatible filters") {}
+    };
 } }
 
 #endif
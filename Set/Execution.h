@@ -0,0 +1,126 @@
+//
+//  Execution.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_Execution_h
+#define Set_Execution_h
+
+#include <execution>
+#include <numeric>
+
+#include "Set.h"
+
+/**
+ @file
+ Overloads of filter_out, for_each and transform_reduce that take a standard execution
+ policy. They run on parallel_for, not on the parallel algorithms of the standard library,
+ but including <execution> is enough for libstdc++ to require TBB at link time when it's
+ installed: link with -ltbb or define _GLIBCXX_USE_TBB_PAR_BACKEND=0 before including it.
+ */
+
+namespace set {
+    
+    namespace utils {
+        
+        /**
+         Enable the overload only for the standard execution policies.
+         */
+        template <typename Policy, typename R = void>
+        using if_policy = typename std::enable_if<std::is_execution_policy<typename std::decay<Policy>::type>::value, R>::type;
+        
+        /**
+         Number of threads to pass to parallel_for for an execution policy: one for the
+         sequenced policies, all the hardware threads for the parallel ones.
+         @param policy the execution policy
+         @returns the number of threads, 0 for all
+         */
+        template <typename Policy>
+        constexpr unsigned threads_for(const Policy&) {
+            using P = typename std::decay<Policy>::type;
+            
+            return std::is_same<P, std::execution::sequenced_policy>::value ||
+                   std::is_same<P, std::execution::unsequenced_policy>::value ? 1 : 0;
+        }
+    }
+    
+    /**
+     Create a new Set from a Set filtering out the elements that pass the predicate,
+     with an execution policy: with the parallel policies the predicate is run on
+     chunks of the elements by different threads and the elements kept are copied
+     in place without checking them again.
+     @param policy the execution policy
+     @param s the set to filter out
+     @param p the function or lambda to use to filter the elements
+     @returns the new Set
+     */
+    template <typename Policy, typename T, typename F, size_t N, typename H, typename E, typename G, typename P>
+    if_policy<Policy, Set<T,F,N,H,E,G>> filter_out(Policy&& policy, const Set<T,F,N,H,E,G>& s, P p) {
+        auto data = s.data();
+        auto threads = threads_for(policy);
+        std::vector<uint8_t> keep(s.size());
+        
+        parallel_for(s.size(), threads, [&](size_t b, size_t e, unsigned) {
+            for (auto i=b; i < e; i++)
+                keep[i] = !p(data[i]);
+        });
+        
+        return Set<T,F,N,H,E,G>(parallel, data, keep, threads);
+    }
+    
+    /**
+     Call the function on every element of the Set, with an execution policy: with
+     the parallel policies each thread calls it on a chunk of the elements.
+     @param policy the execution policy
+     @param s the set
+     @param f the function or lambda to call
+     */
+    template <typename Policy, typename T, typename F, size_t N, typename H, typename E, typename G, typename Function>
+    if_policy<Policy> for_each(Policy&& policy, const Set<T,F,N,H,E,G>& s, Function f) {
+        auto data = s.data();
+        
+        parallel_for(s.size(), threads_for(policy), [&](size_t b, size_t e, unsigned) {
+            std::for_each(data+b, data+e, f);
+        });
+    }
+    
+    /**
+     Transform every element of the Set and reduce the results, with an execution policy:
+     with the parallel policies each thread reduces a chunk of the elements and the
+     partial results are reduced in order. The reduction must be associative and
+     commutative, since the elements of a chunk are reduced in any order.
+     @param policy the execution policy
+     @param s the set
+     @param init the initial value
+     @param reduce the binary function to reduce the values
+     @param transform the function to transform each element
+     @returns the result of the reduction
+     */
+    template <typename Policy, typename T, typename F, size_t N, typename H, typename E, typename G,
+              typename Init, typename Reduce, typename Transform>
+    if_policy<Policy, Init> transform_reduce(Policy&& policy, const Set<T,F,N,H,E,G>& s, Init init,
+                                             Reduce reduce, Transform transform) {
+        auto data = s.data();
+        auto threads = threads_for(policy);
+        if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+        
+        std::vector<Init> partial(threads, init);
+        std::vector<uint8_t> used(threads);
+        
+        parallel_for(s.size(), threads, [&](size_t b, size_t e, unsigned t) {
+            if (b == e) return;
+            
+            partial[t] = std::transform_reduce(data+b+1, data+e, Init(transform(data[b])), reduce, transform);
+            used[t] = 1;
+        });
+        
+        for (unsigned t=0; t < threads; t++)
+            if (used[t]) init = reduce(init, partial[t]);
+        
+        return init;
+    }
+}
+
+#endif
@@ -12,6 +12,10 @@
 #include <cstdlib>
 #include <memory>
 #include <algorithm>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <vector>
 
 namespace set { namespace filters {
 
@@ -25,36 +29,56 @@ namespace set { namespace filters {
     class BaseFilter {
         
     public:
-        void add(const T t) { }
+        void add(const T& t) { }
         
-        Query query(const T t) {
+        template <typename U>
+        Query query(const U& t) {
             return Query::MAYBE;
         }
         
-        void remove(const T t) { }
+        template <typename U>
+        void remove(const U& t) { }
     };
     
     /**
      Class that implements a BloomFilter for O(1) check if an element is NOT present
      into the Set. Query could return false-positive, that's why in the event the element
      is found it returns MAYBE.
+     The counters are 8 bits and saturate: once at 255 they're never decremented.
      
-     @param SIZE the size of the bloomfilter array
+     @param SIZE the initial size of the bloomfilter array
      @param K the number of hashing functions
+     @param Hash the hash function
      */
-    template <typename T, size_t SIZE = 1000, size_t K = 5>
+    template <typename T, size_t SIZE = 1000, size_t K = 5, typename Hash = hasher<T>>
     class BloomFilter {
-        
+    
     public:
-        BloomFilter(): bloom(std::unique_ptr<uint8_t[]>(new uint8_t[SIZE]())) {};
+        /**
+         Constructor, filters built with the same seed can be merged.
+         @param seed_ the seed of the hash functions
+         */
+        BloomFilter(size_t seed_ = 0): seed(seed_), bloom(std::unique_ptr<uint8_t[]>(new uint8_t[SIZE]())) {};
+        
+        /**
+         Copy constructor, copies the counters.
+         @param other the filter to copy
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        BloomFilter(const BloomFilter& other): seed(other.seed),
+                                               size(other.size),
+                                               hashfn(other.hashfn),
+                                               bloom(std::unique_ptr<uint8_t[]>(new uint8_t[other.size])) {
+            std::copy(other.bloom.get(), other.bloom.get()+size, bloom.get());
+        }
         
         /**
          Add the value t to the bloomfilter
          @param t value to add
          */
-        void add(const T t) {
+        void add(const T& t) {
             for (int i=0; i < K; i++)
-                bloom[hash(t, SIZE, i)]++;
+                increment(bloom[hash(t, size, i, seed, hashfn)]);
         }
         
         /**
@@ -63,9 +87,10 @@ namespace set { namespace filters {
          @param t value to query
          @returns Query query result
          */
-        Query query(const T t) {
+        template <typename U>
+        Query query(const U& t) {
             for (int i=0; i < K; i++)
-                if (!bloom[hash(t, SIZE, i)]) return Query::NOT_FOUND;
+                if (!bloom[hash(t, size, i, seed, hashfn)]) return Query::NOT_FOUND;
             
             return Query::MAYBE;
         }
@@ -74,12 +99,163 @@ namespace set { namespace filters {
          Remove the value t from the bloomfilter
          @param t value to remove
          */
-        void remove(const T t) {
+        template <typename U>
+        void remove(const U& t) {
             for (int i=0; i < K; i++)
-                bloom[hash(t, SIZE, i)]--;
+                decrement(bloom[hash(t, size, i, seed, hashfn)]);
         }
         
+        /**
+         Add the counters of the other filter to the counters of this one, so that
+         the filter contains the values of both, saturating at MAX.
+         The values in both filters are counted twice, so after the merge removing
+         them once leaves their counters set: the filter stays correct, without
+         false negatives, but answers MAYBE for them until they're removed twice.
+         @param other the filter to merge
+         @exception incompatible() if the filters have different seeds or sizes
+         */
+        void merge(const BloomFilter& other) {
+            if (seed != other.seed || size != other.size)
+                throw exceptions::incompatible();
+            
+            for (int i=0; i < size; i++)
+                bloom[i] = std::min<unsigned>(MAX, bloom[i] + other.bloom[i]);
+        }
+        
+        /**
+         Make room for n values, enlarging the counters so that the false positive
+         rate stays low, size = n * K / ln(2). Works only while the filter is empty,
+         since the values can't be hashed again.
+         @param n the number of values expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve(size_t n) {
+            auto s = static_cast<size_t>(n * K / 0.69) + 1;
+            
+            if (s <= size || std::any_of(bloom.get(), bloom.get()+size, [](uint8_t c) { return c; }))
+                return;
+            
+            size = s;
+            bloom = std::unique_ptr<uint8_t[]>(new uint8_t[size]());
+        }
+        
+        /**
+         Write the seed, the size and the counters on a stream.
+         @param os stream to write on
+         */
+        void save(std::ostream& os) const {
+            os.write(reinterpret_cast<const char*>(&seed), sizeof(seed));
+            os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            os.write(reinterpret_cast<const char*>(bloom.get()), size);
+        }
+        
+        /**
+         Read the seed, the size and the counters written by save.
+         @param is stream to read from
+         @exception runtime_error if the stream ends before the filter
+         */
+        void load(std::istream& is) {
+            is.read(reinterpret_cast<char*>(&seed), sizeof(seed));
+            is.read(reinterpret_cast<char*>(&size), sizeof(size));
+            
+            if (!is)
+                throw std::runtime_error("Truncated filter");
+            
+            bloom = std::unique_ptr<uint8_t[]>(new uint8_t[size]);
+            is.read(reinterpret_cast<char*>(bloom.get()), size);
+            
+            if (!is)
+                throw std::runtime_error("Truncated filter");
+        }
+        
+        /**
+         Add n values, hashing BATCH values at time and prefetching their counters
+         before updating them.
+         @param keys pointer to the first value
+         @param n number of values
+         */
+        void add_many(const T* keys, size_t n) {
+            size_t h[BATCH][K];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                locate(keys+b, len, h);
+                
+                for (size_t i=0; i < len; i++)
+                    for (int k=0; k < K; k++)
+                        increment(bloom[h[i][k]]);
+            }
+        }
+        
+        /**
+         Query n values, hashing BATCH values at time and prefetching their counters
+         before checking them.
+         @param keys pointer to the first value
+         @param n number of values
+         @param out where to write the n results
+         */
+        template <typename U>
+        void query_many(const U* keys, size_t n, Query* out) {
+            size_t h[BATCH][K];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                locate(keys+b, len, h);
+                
+                for (size_t i=0; i < len; i++) {
+                    out[b+i] = Query::MAYBE;
+                    
+                    for (int k=0; k < K; k++)
+                        if (!bloom[h[i][k]]) {
+                            out[b+i] = Query::NOT_FOUND;
+                            break;
+                        }
+                }
+            }
+        }
+    
     private:
+        static constexpr unsigned MAX = 255;
+        
+        /**
+         Increment a counter, a counter at MAX stays there since it has lost count.
+         @param c the counter
+         */
+        static void increment(uint8_t& c) {
+            if (c < MAX) c++;
+        }
+        
+        /**
+         Decrement a counter, unless it's at MAX, so that it never reaches zero
+         while some value still sets it.
+         @param c the counter
+         */
+        static void decrement(uint8_t& c) {
+            if (c && c < MAX) c--;
+        }
+        
+        /**
+         Compute the K counters of len values and prefetch them.
+         @param keys pointer to the first value
+         @param len number of values, at most BATCH
+         @param h where to write the positions of the counters
+         */
+        template <typename U>
+        void locate(const U* keys, size_t len, size_t (&h)[BATCH][K]) {
+            for (size_t i=0; i < len; i++) {
+                auto p = hash_pair(keys[i], seed, hashfn);
+                
+                for (int k=0; k < K; k++) {
+                    h[i][k] = (p.first + k*p.second) % size;
+                    prefetch(&bloom[h[i][k]]);
+                }
+            }
+        }
+        
+        size_t seed;
+        size_t size = SIZE;
+        
+        Hash hashfn;
         std::unique_ptr<uint8_t[]> bloom;
     };
     
@@ -92,20 +268,45 @@ namespace set { namespace filters {
      @param STASH_SIZE the size of the stash
      @param MAX_DEPTH the depth cutoff
      @param FIXED if the table is fixed
+     @param Hash the hash function
+     @param KeyEqual the equality
      */
     template <typename T,
               size_t SIZE = 1000,
               size_t K = 2,
               size_t STASH_SIZE = 2,
               size_t MAX_DEPTH = 100,
-              bool   FIXED = false>
+              bool   FIXED = false,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>>
     class CuckooTable {
-        
+    
     public:
-        CuckooTable(): table(std::unique_ptr<Nest[]>(new Nest[SIZE]())),
-                       stash(std::unique_ptr<T[]>(new T[STASH_SIZE]())) {
+        /**
+         Constructor, the seed selects the hash functions and the sequence of the kicks,
+         so that tables built with the same seed and elements are equal.
+         @param seed_ the seed
+         */
+        CuckooTable(size_t seed_ = 0): seed(seed_),
+                                       random(seed_),
+                                       stash(std::unique_ptr<T[]>(new T[STASH_SIZE]())),
+                                       table(SIZE) {}
         
-            srand (static_cast<int>(time(NULL)));
+        /**
+         Copy constructor, copies the nests and the stash keeping the same seed.
+         @param other the table to copy
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        CuckooTable(const CuckooTable& other): seed(other.seed),
+                                               size(other.size),
+                                               stash_use(other.stash_use),
+                                               random(other.random),
+                                               hashfn(other.hashfn),
+                                               equal(other.equal),
+                                               stash(std::unique_ptr<T[]>(new T[STASH_SIZE]())),
+                                               table(other.size) {
+            std::copy(other.stash.get(), other.stash.get()+STASH_SIZE, stash.get());
+            std::copy(other.table.get(), other.table.get()+size, table.get());
         }
         
         /**
@@ -119,11 +320,11 @@ namespace set { namespace filters {
          @param depth the depth cutoff for the recursion
          @exception runtime_error if the table is fixed and full.
          */
-        void add(const T t, int i=0, int depth=0) {
+        void add(const T& t, int i=0, int depth=0) {
             if (query(t) == Query::FOUND) return;
             
             for (int k=i; k < K; k++) {
-                auto h = hash(t, size, k, seed);
+                auto h = hash(t, size, k, seed, hashfn);
                 
                 if (!table[h].full) {
                     table[h].insert(t, k+1);
@@ -132,14 +333,24 @@ namespace set { namespace filters {
                 }
             }
             
-            auto index = hash(t, size, rand() % K, seed);
+            int k = random() % K;
+            auto index = hash(t, size, k, seed, hashfn);
+            
+            // the nests before the i-th weren't checked
+            if (!table[index].full) {
+                table[index].insert(t, k+1);
+                
+                return;
+            }
             
             if (depth == MAX_DEPTH) {
-                if (stash_use < STASH_SIZE-1)
-                    stash[++stash_use] = t;
+                if (stash_use < STASH_SIZE)
+                    stash[stash_use++] = t;
                 
-                else if (!FIXED)
+                else if (!FIXED) {
                     rebuild(index);
+                    add(t);
+                }
                 
                 else
                     throw std::runtime_error("Full");
@@ -153,22 +364,55 @@ namespace set { namespace filters {
             add(node.t, node.i, ++depth);
         }
         
+        /**
+         Make room for n elements, rehashing the elements in a larger table
+         if the load would be above one half.
+         @param n the number of elements expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve(size_t n) {
+            if (2*n > size) rebuild(seed, 2*n);
+        }
+        
+        /**
+         Add the elements of the other table to this one, the tables don't need
+         to have the same seed.
+         @param other the table to merge
+         @exception runtime_error if the table is fixed and full.
+         */
+        void merge(const CuckooTable& other) {
+            for (int i=0; i < other.size; i++)
+                if (other.table[i].full)
+                    add(other.table[i].t);
+            
+            for (int i=0; i < other.stash_use; i++)
+                add(other.stash[i]);
+        }
+        
         /**
          Search K-nests for the element to remove.
          @param t the element to remove
          */
-        void remove(const T t) {
+        template <typename U>
+        void remove(const U& t) {
             if (query(t) == Query::NOT_FOUND) return;
             
             for (int k=0; k < K; k++) {
-                auto h = hash(t, size, k, seed);
+                auto h = hash(t, size, k, seed, hashfn);
                 
-                if (table[h].t == t) {
+                if (table[h].full && equal(table[h].t, t)) {
                     table[h].clear();
                     
                     return;
                 }
             }
+            
+            for (int i=0; i < stash_use; i++)
+                if (equal(stash[i], t)) {
+                    stash[i] = stash[--stash_use];
+                    
+                    return;
+                }
         }
         
         /**
@@ -176,39 +420,112 @@ namespace set { namespace filters {
          @param t the element
          @returns the Query result
          */
-        Query query(const T t) {
+        template <typename U>
+        Query query(const U& t) {
             for (int k=0; k < K; k++) {
-                auto h = hash(t, size, k, seed);
+                auto h = hash(t, size, k, seed, hashfn);
                 
-                if (table[h].full && table[h].t == t) return Query::FOUND;
+                if (table[h].full && equal(table[h].t, t)) return Query::FOUND;
             }
             
-            for (int i=0; i < STASH_SIZE; i++)
-                if (stash[i] == t) return Query::FOUND;
+            for (int i=0; i < stash_use; i++)
+                if (equal(stash[i], t)) return Query::FOUND;
             
             return Query::NOT_FOUND;
         }
         
+        /**
+         Add n elements, prefetching the nests of BATCH elements at time before
+         inserting them one by one.
+         @param keys pointer to the first element
+         @param n number of elements
+         */
+        void add_many(const T* keys, size_t n) {
+            size_t h[BATCH][K];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                locate(keys+b, len, h);
+                
+                for (size_t i=0; i < len; i++)
+                    add(keys[b+i]);
+            }
+        }
+        
+        /**
+         Query n elements, hashing BATCH elements at time and prefetching their
+         nests before comparing them.
+         @param keys pointer to the first element
+         @param n number of elements
+         @param out where to write the n results
+         */
+        template <typename U>
+        void query_many(const U* keys, size_t n, Query* out) {
+            size_t h[BATCH][K];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                locate(keys+b, len, h);
+                
+                for (size_t i=0; i < len; i++) {
+                    out[b+i] = Query::NOT_FOUND;
+                    
+                    for (int k=0; k < K && out[b+i] == Query::NOT_FOUND; k++) {
+                        auto& nest = table[h[i][k]];
+                        if (nest.full && equal(nest.t, keys[b+i])) out[b+i] = Query::FOUND;
+                    }
+                    
+                    for (int j=0; j < stash_use && out[b+i] == Query::NOT_FOUND; j++)
+                        if (equal(stash[j], keys[b+i])) out[b+i] = Query::FOUND;
+                }
+            }
+        }
+    
     private:
+        /**
+         Compute the K nests of len elements and prefetch them.
+         @param keys pointer to the first element
+         @param len number of elements, at most BATCH
+         @param h where to write the positions of the nests
+         */
+        template <typename U>
+        void locate(const U* keys, size_t len, size_t (&h)[BATCH][K]) {
+            for (size_t i=0; i < len; i++) {
+                auto p = hash_pair(keys[i], seed, hashfn);
+                
+                for (int k=0; k < K; k++) {
+                    h[i][k] = (p.first + k*p.second) % size;
+                    prefetch(&table[h[i][k]]);
+                }
+            }
+        }
+        
         /**
          Rebuilds the table, increasing the size and using the last element 
-         hash as the new seed of the hash functions.
+         hash as the new seed of the hash functions, the elements in the
+         old table and in the stash are inserted again.
+         The elements are set aside and the table is resized in place, so that
+         a table mapped with huge pages is remapped instead of allocated again.
          @param seed_ the new seed
+         @param size_ the new size, twice the current one if 0
          */
-        void rebuild(size_t seed_) {
-            auto old_table = std::move(table);
-            auto old_size = size;
+        void rebuild(size_t seed_, size_t size_ = 0) {
+            std::vector<T> old;
+            
+            for (int i=0; i < size; i++)
+                if (table[i].full)
+                    old.push_back(table[i].t);
+            
+            old.insert(old.end(), stash.get(), stash.get()+stash_use);
             
-            size *= 2;
+            size = size_ ? size_ : 2*size;
             stash_use = 0;
             seed = seed_;
-            table = std::unique_ptr<Nest[]>(new Nest[size]());
+            table.resize(size, 0);
+            stash = std::unique_ptr<T[]>(new T[STASH_SIZE]());
             
-            for (int i=0; i < old_size; i++) {
-                auto t = old_table[i].t;
-                
+            for (auto& t: old)
                 add(t);
-            }
         }
         
         /**
@@ -221,7 +538,7 @@ namespace set { namespace filters {
             
             Nest(): full(0), i(0), t(T()) {};
             
-            void insert(const T t_, uint i_) {
+            void insert(const T& t_, uint i_) {
                 assert(!full);
                 full = true;
                 
@@ -229,23 +546,28 @@ namespace set { namespace filters {
                 i = i_;
             }
             
-            void swap(const T t_) {
+            void swap(const T& t_) {
                 assert(full);
                 t = t_;
             }
             
             void clear() {
                 full = 0;
-                t.~T();
+                t = T();
             }
         };
         
-        size_t seed = 0;
+        size_t seed;
         size_t size = SIZE;
         size_t stash_use = 0;
         
+        std::minstd_rand random;
+        
+        Hash hashfn;
+        KeyEqual equal;
+        
         std::unique_ptr<T[]> stash;
-        std::unique_ptr<Nest[]> table;
+        Buffer<Nest> table;
     };
  
     
@@ -253,14 +575,16 @@ namespace set { namespace filters {
      Class to implement a CuckooFilter, a lot similar to the Cuckoo Hash Table, but 
      instead of storing the element, it stores the fingerprint (just another hash) and 
      makes use of partial hashing for easily retrieve the second hash from the first.
-     @param SIZE the size of the filter
+     @param SIZE the initial number of rows of the filter
      @param BUCKETS the number of buckets to use.
      @param MAX_DEPTH depth cutoff in case of eviction.
+     @param Hash the hash function
      */
     template <typename T,
     size_t SIZE = 100,
     size_t BUCKETS = 4,
-    size_t MAX_DEPTH = 100>
+    size_t MAX_DEPTH = 100,
+    typename Hash = hasher<T>>
     
     class CuckooFilter {
         
@@ -299,22 +623,34 @@ namespace set { namespace filters {
         };
 
     public:
-        CuckooFilter() {
-            srand (static_cast<int>(time(NULL)));
+        /**
+         Constructor, filters built with the same seed can be merged.
+         @param seed_ the seed of the hash functions and of the kicks
+         */
+        CuckooFilter(size_t seed_ = 0): seed(seed_), random(seed_) {}
             
-            for (int i=0; i < SIZE; i++) {
-                table[i] = Row(new Nest[BUCKETS]());
-            }
+        /**
+         Copy constructor, copies every row of fingerprints.
+         @param other the filter to copy
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        CuckooFilter(const CuckooFilter& other): seed(other.seed),
+                                                 size(other.size),
+                                                 random(other.random),
+                                                 hashfn(other.hashfn),
+                                                 table(other.size * BUCKETS) {
+            std::copy(other.table.get(), other.table.get()+size*BUCKETS, table.get());
         }
  
-        void add(const T t) {
+        void add(const T& t) {
             auto res = lookup(t);
             if (res.found) return;
             
             move(res.fingerprint, res.h1);
         }
         
-        void remove(const T t) {
+        template <typename U>
+        void remove(const U& t) {
             auto res = lookup(t);
             
             if (!res.found) return;
@@ -323,16 +659,128 @@ namespace set { namespace filters {
             if (remove_fp(res.fingerprint, res.h2)) return;
         }
         
-        Query query(const T t) {
+        template <typename U>
+        Query query(const U& t) {
             auto res = lookup(t);
             if (res.found) return Query::MAYBE;
             
             return Query::NOT_FOUND;
         }
+        
+        /**
+         Insert the fingerprints of the other filter in this one, starting from the
+         row where they are, the ones already in this filter are skipped.
+         @param other the filter to merge
+         @exception incompatible() if the filters have different seeds or sizes
+         @exception runtime_error if the filter is full
+         */
+        void merge(const CuckooFilter& other) {
+            if (seed != other.seed || size != other.size)
+                throw exceptions::incompatible();
+            
+            for (size_t r=0; r < size; r++)
+                for (int i=0; i < BUCKETS; i++) {
+                    auto& nest = other.row(r)[i];
+                    if (!nest.full) continue;
+                    
+                    Result res;
+                    res.fingerprint = nest.fingerprint;
+                    res.h1 = r;
+                    res.h2 = (r ^ hash(nest.fingerprint, size, 900, seed)) % size;
+                    
+                    if (!scan(res)) move(res.fingerprint, r);
+                }
+        }
+        
+        /**
+         Make room for n elements, adding rows so that the load stays below 90%.
+         Works only while the filter is empty, since the rows of the fingerprints
+         depend on the number of rows.
+         @param n the number of elements expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve(size_t n) {
+            auto rows = static_cast<size_t>(n / (0.9 * BUCKETS)) + 1;
+            if (rows <= size) return;
+            
+            for (size_t r=0; r < size; r++)
+                for (int i=0; i < BUCKETS; i++)
+                    if (row(r)[i].full) return;
+            
+            size = rows;
+            table = Buffer<Nest>(size * BUCKETS);
+        }
+        
+        /**
+         Write the seed, the number of rows and the fingerprints on a stream.
+         @param os stream to write on
+         */
+        void save(std::ostream& os) const {
+            os.write(reinterpret_cast<const char*>(&seed), sizeof(seed));
+            os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            
+            for (size_t r=0; r < size; r++)
+                for (int i=0; i < BUCKETS; i++) {
+                    size_t fp = row(r)[i].full ? row(r)[i].fingerprint + 1 : 0;
+                    os.write(reinterpret_cast<const char*>(&fp), sizeof(fp));
+                }
+        }
+        
+        /**
+         Read the seed, the number of rows and the fingerprints written by save.
+         @param is stream to read from
+         @exception runtime_error if the stream ends before the filter
+         */
+        void load(std::istream& is) {
+            is.read(reinterpret_cast<char*>(&seed), sizeof(seed));
+            is.read(reinterpret_cast<char*>(&size), sizeof(size));
+            
+            if (!is)
+                throw std::runtime_error("Truncated filter");
+            
+            table = Buffer<Nest>(size * BUCKETS);
+            
+            for (size_t r=0; r < size; r++)
+                for (int i=0; i < BUCKETS; i++) {
+                    size_t fp = 0;
+                    is.read(reinterpret_cast<char*>(&fp), sizeof(fp));
+                    
+                    if (fp) row(r)[i].insert(fp - 1);
+                }
+            
+            if (!is)
+                throw std::runtime_error("Truncated filter");
+        }
+        
+        /**
+         Query n elements, computing the fingerprints and the rows of BATCH elements
+         at time and prefetching the rows before scanning them.
+         @param keys pointer to the first element
+         @param n number of elements
+         @param out where to write the n results
+         */
+        template <typename U>
+        void query_many(const U* keys, size_t n, Query* out) {
+            Result res[BATCH];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                
+                for (size_t i=0; i < len; i++) {
+                    res[i] = locate(keys[b+i]);
+                    
+                    prefetch(row(res[i].h1));
+                    prefetch(row(res[i].h2));
+                }
+                
+                for (size_t i=0; i < len; i++)
+                    out[b+i] = scan(res[i]) ? Query::MAYBE : Query::NOT_FOUND;
+            }
+        }
     
     private:
         void move(size_t fingerprint, size_t h1, int depth=0) {
-            auto h2 = (h1 ^ hash(fingerprint, size, 900, seed)) % SIZE;
+            auto h2 = (h1 ^ hash(fingerprint, size, 900, seed)) % size;
             
             if (add_fp(fingerprint, h1)) return;
             if (add_fp(fingerprint, h2)) return;
@@ -340,49 +788,65 @@ namespace set { namespace filters {
             if (depth == MAX_DEPTH)
                 throw std::runtime_error("Full");
             
-            auto row = rand() % 2 == 0 ? h1 : h2;
-            auto col = rand() % 4;
+            auto r = random() % 2 == 0 ? h1 : h2;
+            auto col = random() % BUCKETS;
             
-            auto elem = table[row][col].fingerprint;
-            table[row][col].swap(fingerprint);
+            auto elem = row(r)[col].fingerprint;
+            row(r)[col].swap(fingerprint);
             
-            move(elem, row);
+            move(elem, r);
         }
         
-        Result lookup(const T t) {
-            auto fingerprint = hash(t, size, 1000, seed);
-            auto h1 = hash(t, size, 0, seed);
-            auto h2 = (h1 ^ hash(fingerprint, size, 900, seed)) % SIZE;
+        template <typename U>
+        Result lookup(const U& t) {
+            auto res = locate(t);
+            res.found = scan(res);
+            
+            return res;
+        }
+        
+        /**
+         Compute the fingerprint and the two rows of the element.
+         @param t the element
+         @returns the Result, not searched yet
+         */
+        template <typename U>
+        Result locate(const U& t) {
+            auto p = hash_pair(t, seed, hashfn);
             
             Result res;
+            res.fingerprint = (p.first + 1000*p.second) % size;
+            res.h1 = p.first % size;
+            res.h2 = (res.h1 ^ hash(res.fingerprint, size, 900, seed)) % size;
+            
+            return res;
+        }
+        
+        /**
+         Search the fingerprint in the two rows.
+         @param res the fingerprint and the rows
+         @returns true if found
+         */
+        bool scan(const Result& res) {
             for (int i=0; i < BUCKETS; i++) {
-                auto& n1 = table[h1][i];
+                auto& n1 = row(res.h1)[i];
                 
-                if (n1.full && n1.fingerprint == fingerprint) {
-                    res.found = true;
-                    break;
-                }
-
-                auto& n2 = table[h2][i];
+                if (n1.full && n1.fingerprint == res.fingerprint)
+                    return true;
                 
-                if (n2.full && n2.fingerprint == fingerprint) {
-                    res.found = true;
-                    break;
-                }
-
+                auto& n2 = row(res.h2)[i];
+                
+                if (n2.full && n2.fingerprint == res.fingerprint)
+                    return true;
             }
             
-            res.fingerprint = fingerprint;
-            res.h1 = h1;
-            res.h2 = h2;
-            
-            return res;
+            return false;
         }
         
         bool add_fp(size_t fp, size_t h) {
             for (int i=0; i < BUCKETS; i++) {
-                if (!table[h][i].full) {
-                    table[h][i].insert(fp);
+                if (!row(h)[i].full) {
+                    row(h)[i].insert(fp);
                     
                     return true;
                 }
@@ -393,8 +857,8 @@ namespace set { namespace filters {
         
         bool remove_fp(size_t fp, size_t h) {
             for (int i=0; i < BUCKETS; i++)
-                if (table[h][i].full && table[h][i].fingerprint == fp) {
-                    table[h][i].full = 0;
+                if (row(h)[i].full && row(h)[i].fingerprint == fp) {
+                    row(h)[i].full = 0;
                     
                     return true;
                 }
@@ -402,15 +866,416 @@ namespace set { namespace filters {
             return false;
         }
         
-        size_t seed = 0;
+        /**
+         Return the BUCKETS nests of a row, stored contiguously.
+         @param r the row
+         @returns pointer to the first nest of the row
+         */
+        Nest* row(size_t r) const {
+            return table.get() + r*BUCKETS;
+        }
+        
+        size_t seed;
         size_t size = SIZE;
         
-        using Row   = std::unique_ptr<Nest[]>;
-        using Table = std::unique_ptr<Row[]>;
+        std::minstd_rand random;
+        
+        Hash hashfn;
         
-        Table table = Table(new Row[SIZE]);
+        Buffer<Nest> table = Buffer<Nest>(SIZE * BUCKETS);
     };
     
+    /**
+     Check if the filter F has the batched query_many and add_many.
+     */
+    template <typename F, typename U, typename = void>
+    struct has_query_many: public std::false_type {};
+    
+    template <typename F, typename U>
+    struct has_query_many<F, U, std::void_t<decltype(std::declval<F&>().query_many((const U*)0, 0, (Query*)0))>>:
+        public std::true_type {};
+    
+    template <typename F, typename T, typename = void>
+    struct has_add_many: public std::false_type {};
+    
+    template <typename F, typename T>
+    struct has_add_many<F, T, std::void_t<decltype(std::declval<F&>().add_many((const T*)0, 0))>>:
+        public std::true_type {};
+    
+    /**
+     Check if the filter F can be merged with another one.
+     */
+    template <typename F, typename = void>
+    struct has_merge: public std::false_type {};
+    
+    template <typename F>
+    struct has_merge<F, std::void_t<decltype(std::declval<F&>().merge(std::declval<const F&>()))>>:
+        public std::true_type {};
+    
+    /**
+     Check if the filter F can be presized with reserve.
+     */
+    template <typename F, typename = void>
+    struct has_reserve: public std::false_type {};
+    
+    template <typename F>
+    struct has_reserve<F, std::void_t<decltype(std::declval<F&>().reserve(size_t()))>>:
+        public std::true_type {};
+    
+    /**
+     Check if the filter F reports the memory it uses.
+     */
+    template <typename F, typename = void>
+    struct has_bytes: public std::false_type {};
+    
+    template <typename F>
+    struct has_bytes<F, std::void_t<decltype(std::declval<const F&>().bytes())>>:
+        public std::true_type {};
+    
+    /**
+     Query n values with the batched query of the filter, or one by one if it doesn't have one.
+     @param f the filter
+     @param keys pointer to the first value
+     @param n number of values
+     @param out where to write the n results
+     */
+    template <typename F, typename U>
+    void query_many(F& f, const U* keys, size_t n, Query* out) {
+        if constexpr (has_query_many<F, U>::value)
+            f.query_many(keys, n, out);
+        else
+            for (size_t i=0; i < n; i++)
+                out[i] = f.query(keys[i]);
+    }
+    
+    /**
+     Add n values with the batched add of the filter, or one by one if it doesn't have one.
+     @param f the filter
+     @param keys pointer to the first value
+     @param n number of values
+     */
+    template <typename F, typename T>
+    void add_many(F& f, const T* keys, size_t n) {
+        if constexpr (has_add_many<F, T>::value)
+            f.add_many(keys, n);
+        else
+            for (size_t i=0; i < n; i++)
+                f.add(keys[i]);
+    }
+    
+    /**
+     Merge the other filter into f, if the filter can be merged.
+     @param f the filter
+     @param other the filter to merge
+     @returns true if merged, false if the filter doesn't have merge or the filters are incompatible
+     */
+    template <typename F>
+    bool merge(F& f, const F& other) {
+        if constexpr (has_merge<F>::value)
+            try {
+                f.merge(other);
+                return true;
+            } catch (exceptions::incompatible) {
+                return false;
+            }
+        
+        return false;
+    }
+    
+    /**
+     Memory used by the filter, only the size of the object if the filter doesn't report it.
+     @param f the filter
+     @returns the size in bytes
+     */
+    template <typename F>
+    size_t bytes(const F& f) {
+        if constexpr (has_bytes<F>::value)
+            return f.bytes();
+        else
+            return sizeof(F);
+    }
+    
+    /**
+     Make room in the filter for n values, if the filter can be presized.
+     @param f the filter
+     @param n the number of values expected
+     @exception bad_alloc if the allocation isn't successfull
+     */
+    template <typename F>
+    void reserve(F& f, size_t n) {
+        if constexpr (has_reserve<F>::value)
+            f.reserve(n);
+    }
+    
+    /**
+     Class that implements an AdaptiveFilter, it picks the structure to use based on
+     the number of elements and on the false positives measured at runtime.
+     While there are less than THRESHOLD elements it always returns MAYBE, like
+     the BaseFilter, past the threshold it uses the Approx filter, and if the
+     share of queries that lead to a useless scan of the Set exceeds BUDGET percent,
+     it switches to the Exact index.
+     Every time the structure has to change the filter becomes stale, and it has to be
+     refilled with all the elements of the Set through build().
+     
+     @param THRESHOLD the number of elements after which the Approx filter is used
+     @param BUDGET the percent of queries allowed to be false positives
+     @param SAMPLES the number of queries to observe before deciding to switch
+     @param Approx the probabilistic filter
+     @param Exact the exact index
+     */
+    template <typename T,
+              size_t THRESHOLD = 64,
+              size_t BUDGET = 5,
+              size_t SAMPLES = 256,
+              typename Approx = BloomFilter<T>,
+              typename Exact = CuckooTable<T>>
+    class AdaptiveFilter {
+        
+    public:
+        /**
+         Enumerator class to rappresent the structure in use
+         */
+        enum class Mode { NONE, APPROX, EXACT };
+        
+        AdaptiveFilter() =default;
+        
+        /**
+         Copy constructor, copies the structure in use and its statistics.
+         @param other the filter to copy
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        AdaptiveFilter(const AdaptiveFilter& other): mode(other.mode),
+                                                     count(other.count),
+                                                     queries(other.queries),
+                                                     false_positives(other.false_positives),
+                                                     pending(other.pending),
+                                                     reserved(other.reserved) {
+            if (other.approx) approx = std::unique_ptr<Approx>(new Approx(*other.approx));
+            if (other.exact) exact = std::unique_ptr<Exact>(new Exact(*other.exact));
+        }
+        
+        /**
+         Add the value t to the filter, if the last query returned MAYBE the add
+         means that the Set didn't find the element, so it's counted as a false positive.
+         @param t value to add
+         */
+        void add(const T& t) {
+            if (pending) false_positives++;
+            pending = false;
+            
+            count++;
+            if (mode == Mode::APPROX) approx->add(t);
+            else if (mode == Mode::EXACT) exact->add(t);
+        }
+        
+        /**
+         Query the value t using the structure in use.
+         @param t value to query
+         @returns Query query result
+         */
+        template <typename U>
+        Query query(const U& t) {
+            pending = false;
+            
+            if (mode == Mode::EXACT) return exact->query(t);
+            if (mode == Mode::NONE) return Query::MAYBE;
+            
+            auto res = approx->query(t);
+            
+            queries++;
+            pending = res == Query::MAYBE;
+            
+            return res;
+        }
+        
+        /**
+         Remove the value t from the filter
+         @param t value to remove
+         */
+        template <typename U>
+        void remove(const U& t) {
+            pending = false;
+            
+            count--;
+            if (mode == Mode::APPROX) approx->remove(t);
+            else if (mode == Mode::EXACT) exact->remove(t);
+        }
+        
+        /**
+         Add n values to the filter, see add. The false positives are not tracked.
+         @param keys pointer to the first value
+         @param n number of values
+         */
+        void add_many(const T* keys, size_t n) {
+            pending = false;
+            
+            count += n;
+            if (mode == Mode::APPROX) filters::add_many(*approx, keys, n);
+            else if (mode == Mode::EXACT) filters::add_many(*exact, keys, n);
+        }
+        
+        /**
+         Query n values, see query.
+         @param keys pointer to the first value
+         @param n number of values
+         @param out where to write the n results
+         */
+        template <typename U>
+        void query_many(const U* keys, size_t n, Query* out) {
+            pending = false;
+            
+            if (mode == Mode::APPROX) filters::query_many(*approx, keys, n, out);
+            else if (mode == Mode::EXACT) filters::query_many(*exact, keys, n, out);
+            else std::fill(out, out+n, Query::MAYBE);
+        }
+        
+        /**
+         Make room for n values in the structure in use and in the ones
+         built later.
+         @param n the number of values expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve(size_t n) {
+            reserved = n;
+            
+            if (approx) filters::reserve(*approx, n);
+            if (exact) filters::reserve(*exact, n);
+        }
+        
+        /**
+         Merge the other filter into this one, both must use the same structure.
+         @param other the filter to merge
+         @exception incompatible() if the structures in use are different or can't be merged
+         */
+        void merge(const AdaptiveFilter& other) {
+            if (mode != other.mode)
+                throw exceptions::incompatible();
+            
+            if (mode == Mode::APPROX) merge_with(*approx, *other.approx);
+            else if (mode == Mode::EXACT) merge_with(*exact, *other.exact);
+            
+            count += other.count;
+        }
+        
+        /**
+         Check if the filter has to be rebuilt with a different structure.
+         @returns true if the filter is stale
+         */
+        bool stale() const {
+            if (mode == Mode::NONE) return count > THRESHOLD;
+            if (mode == Mode::APPROX)
+                return queries >= SAMPLES && false_positives*100 > queries*BUDGET;
+            
+            return false;
+        }
+        
+        /**
+         Rebuild the filter from the elements of the Set, choosing the structure
+         to use, once switched to the Exact index it never goes back.
+         @param begin first element of the Set
+         @param end element after the last of the Set
+         */
+        template <typename Iterator>
+        void build(Iterator begin, Iterator end) {
+            count = end - begin;
+            
+            if (mode == Mode::APPROX && stale()) mode = Mode::EXACT;
+            else if (mode != Mode::EXACT)
+                mode = count > THRESHOLD ? Mode::APPROX : Mode::NONE;
+            
+            approx.reset();
+            exact.reset();
+            queries = false_positives = 0;
+            pending = false;
+            
+            if (mode == Mode::APPROX) {
+                approx = std::unique_ptr<Approx>(new Approx());
+                filters::reserve(*approx, reserved);
+                
+                for (; begin != end; begin++) approx->add(*begin);
+            } else if (mode == Mode::EXACT) {
+                exact = std::unique_ptr<Exact>(new Exact());
+                filters::reserve(*exact, reserved);
+                
+                for (; begin != end; begin++) exact->add(*begin);
+            }
+        }
+        
+        /**
+         Return the structure in use
+         @returns the current mode
+         */
+        Mode current() const {
+            return mode;
+        }
+    
+    private:
+        /**
+         Merge the structure in use, see merge.
+         @param f the structure of this filter
+         @param other the structure of the other filter
+         @exception incompatible() if the structure can't be merged
+         */
+        template <typename S>
+        static void merge_with(S& f, const S& other) {
+            if (!filters::merge(f, other))
+                throw exceptions::incompatible();
+        }
+        
+        Mode mode = Mode::NONE;
+        
+        size_t count = 0;
+        size_t queries = 0;
+        size_t false_positives = 0;
+        bool pending = false;
+        size_t reserved = 0;
+        
+        std::unique_ptr<Approx> approx;
+        std::unique_ptr<Exact> exact;
+    };
+    
+    /**
+     Check if the filter has to be rebuilt, only adaptive filters can become stale.
+     @param f the filter
+     @returns true if the filter has to be rebuilt
+     */
+    template <typename F>
+    bool stale(const F&) {
+        return false;
+    }
+    
+    template <typename T, size_t TH, size_t B, size_t S, typename A, typename E>
+    bool stale(const AdaptiveFilter<T, TH, B, S, A, E>& f) {
+        return f.stale();
+    }
+    
+    /**
+     Check if the query of the filter F modifies it, like the AdaptiveFilter
+     that counts the false positives.
+     */
+    template <typename F>
+    struct mutating_query: public std::false_type {};
+    
+    template <typename T, size_t TH, size_t B, size_t S, typename A, typename E>
+    struct mutating_query<AdaptiveFilter<T, TH, B, S, A, E>>: public std::true_type {};
+    
+    /**
+     Fill the filter with the elements between begin and end.
+     @param f the filter
+     @param begin first element
+     @param end element after the last
+     */
+    template <typename F, typename Iterator>
+    void build(F& f, Iterator begin, Iterator end) {
+        for (; begin != end; begin++)
+            f.add(*begin);
+    }
+    
+    template <typename T, size_t TH, size_t B, size_t S, typename A, typename E, typename Iterator>
+    void build(AdaptiveFilter<T, TH, B, S, A, E>& f, Iterator begin, Iterator end) {
+        f.build(begin, end);
+    }
+    
 }}
 
 #endif
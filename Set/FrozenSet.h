@@ -0,0 +1,291 @@
+//
+//  FrozenSet.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_FrozenSet_h
+#define Set_FrozenSet_h
+
+#include <atomic>
+
+#include "Set.h"
+
+namespace set {
+    
+    /**
+     Class that implement an immutable Set-like structure built from a Set, with random
+     access in O(1), ordered by insertion, and exact lookup in O(1) through a minimal
+     perfect hash function that maps each element to its index.
+     The minimal perfect hash follows BBHash (https://arxiv.org/abs/1702.03154): every
+     level is a bit array GAMMA times larger than the elements left, the elements that
+     don't collide with any other set their bit, the others go to the next level.
+     The index of an element is the rank of its bit among all the levels, it costs about
+     3.7 bits per element with GAMMA = 2, plus 4 bytes per element to map it to the
+     position in the Set.
+     The levels are built in parallel, each thread hashes a chunk of the elements.
+     
+     @param T the type of the values inside the Set
+     @param Hash the hash function
+     @param KeyEqual the equality used to compare the elements
+     @param GAMMA the size of each level, relative to the elements left
+     */
+    template <typename T,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>,
+              size_t GAMMA = 2>
+    class FrozenSet {
+        
+        static constexpr size_t MAX_LEVELS = 32;
+        static constexpr size_t BLOCK = 8;
+        
+        /**
+         Struct that rappresent a level of the minimal perfect hash, the bits
+         of all the levels are stored one after the other.
+         */
+        struct Level {
+            size_t offset;
+            size_t size;
+        };
+    
+    public:
+        using const_iterator = const T*;
+        
+        /**
+         Constructor from a Set, copies the elements and builds the minimal perfect hash.
+         @param set the set to freeze
+         @param threads the number of threads to use, 0 to use all the hardware threads
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename F, size_t N, typename G>
+        FrozenSet(const Set<T, F, N, Hash, KeyEqual, G>& set, unsigned threads = 0):
+            count(set.size()),
+            data(std::unique_ptr<T[]>(new T[set.size()])) {
+            
+            std::copy(set.begin(), set.end(), data.get());
+            build(threads);
+        }
+        
+        /**
+         Subscribe operator to access element by index in costant time
+         @param p the index of the element to retrieve
+         @returns const reference to the element
+         */
+        const T& operator[](size_t p) const {
+            return data[p];
+        }
+        
+        /**
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        size_t size() const {
+            return count;
+        }
+        
+        /**
+         Check if an element is in the Set.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        template <typename U>
+        bool contains(const U& t) const {
+            return index_of(t) != -1;
+        }
+        
+        /**
+         Return the index of an element, computing its minimal perfect hash and
+         comparing it with the element at that index.
+         @param t the element
+         @returns the index of the element, -1 if not found
+         */
+        template <typename U>
+        long index_of(const U& t) const {
+            auto h = hashfn(t);
+            
+            for (size_t l=0; l < levels.size(); l++) {
+                auto bit = levels[l].offset + slot(h, l);
+                
+                if (test(bit)) {
+                    auto p = positions[rank(bit)];
+                    
+                    return equal(data[p], t) ? long(p) : -1;
+                }
+            }
+            
+            for (auto p: fallback)
+                if (equal(data[p], t)) return long(p);
+            
+            return -1;
+        }
+        
+        /**
+         Return the const_iterator, pointing at the first element
+         @returns the const_iterator
+         */
+        const_iterator begin() const {
+            return data.get();
+        }
+        
+        /**
+         Return the const_iterator, pointing at the element after the last
+         @returns the const_iterator
+         */
+        const_iterator end() const {
+            return data.get() + count;
+        }
+    
+    private:
+        /**
+         Hash the element for the level l and reduce it in the range of the level.
+         @param h the hash of the element
+         @param l the level
+         @returns the position of the bit inside the level
+         */
+        size_t slot(size_t h, size_t l) const {
+            return static_hasher<uint64_t>::mix(h + (l+1) * 0x9e3779b97f4a7c15ull) % levels[l].size;
+        }
+        
+        /**
+         Check if the bit is set.
+         @param bit the position of the bit
+         @returns true if set
+         */
+        bool test(size_t bit) const {
+            return bits[bit / 64] >> (bit % 64) & 1;
+        }
+        
+        /**
+         Count the bits set before the bit, using the counts sampled every BLOCK words.
+         @param bit the position of the bit
+         @returns the rank of the bit
+         */
+        size_t rank(size_t bit) const {
+            auto w = bit / 64;
+            size_t r = samples[w / BLOCK];
+            
+            for (auto i = w - w % BLOCK; i < w; i++)
+                r += __builtin_popcountll(bits[i]);
+            
+            return r + __builtin_popcountll(bits[w] & ((uint64_t(1) << (bit % 64)) - 1));
+        }
+        
+        /**
+         Build the minimal perfect hash, one level at time, then map each element
+         to its position in the Set.
+         @param threads the number of threads to use
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void build(unsigned threads) {
+            if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+            
+            std::vector<size_t> hashes(count);
+            std::vector<size_t> keys(count);
+            
+            parallel_for(count, threads, [&](size_t b, size_t e, unsigned) {
+                for (auto i=b; i < e; i++) {
+                    hashes[i] = hashfn(data[i]);
+                    keys[i] = i;
+                }
+            });
+            
+            std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> words;
+            size_t total = 0;
+            
+            while (!keys.empty() && levels.size() < MAX_LEVELS) {
+                auto l = levels.size();
+                auto size = std::max<size_t>(64, (GAMMA * keys.size() + 63) / 64 * 64);
+                
+                levels.push_back({total, size});
+                total += size;
+                
+                std::unique_ptr<std::atomic<uint64_t>[]> seen(new std::atomic<uint64_t>[size / 64]());
+                std::unique_ptr<std::atomic<uint64_t>[]> collide(new std::atomic<uint64_t>[size / 64]());
+                
+                parallel_for(keys.size(), threads, [&](size_t b, size_t e, unsigned) {
+                    for (auto i=b; i < e; i++) {
+                        auto s = slot(hashes[keys[i]], l);
+                        auto mask = uint64_t(1) << (s % 64);
+                        
+                        if (seen[s / 64].fetch_or(mask) & mask)
+                            collide[s / 64].fetch_or(mask);
+                    }
+                });
+                
+                std::vector<std::vector<size_t>> left(threads);
+                
+                parallel_for(keys.size(), threads, [&](size_t b, size_t e, unsigned t) {
+                    for (auto i=b; i < e; i++) {
+                        auto s = slot(hashes[keys[i]], l);
+                        
+                        if (collide[s / 64].load() >> (s % 64) & 1)
+                            left[t].push_back(keys[i]);
+                    }
+                });
+                
+                for (size_t w=0; w < size / 64; w++)
+                    seen[w].store(seen[w].load() & ~collide[w].load());
+                
+                words.push_back(std::move(seen));
+                
+                keys.clear();
+                for (auto& v: left)
+                    keys.insert(keys.end(), v.begin(), v.end());
+            }
+            
+            fallback = std::move(keys);
+            
+            bits = std::unique_ptr<uint64_t[]>(new uint64_t[total / 64 + 1]());
+            samples = std::unique_ptr<size_t[]>(new size_t[total / 64 / BLOCK + 1]());
+            
+            size_t w = 0, r = 0;
+            for (size_t l=0; l < levels.size(); l++)
+                for (size_t i=0; i < levels[l].size / 64; i++, w++) {
+                    if (w % BLOCK == 0) samples[w / BLOCK] = r;
+                    
+                    bits[w] = words[l][i].load();
+                    r += __builtin_popcountll(bits[w]);
+                }
+            
+            positions = std::unique_ptr<uint32_t[]>(new uint32_t[r + 1]);
+            
+            parallel_for(count, threads, [&](size_t b, size_t e, unsigned) {
+                for (auto i=b; i < e; i++)
+                    for (size_t l=0; l < levels.size(); l++) {
+                        auto bit = levels[l].offset + slot(hashes[i], l);
+                        
+                        if (test(bit)) {
+                            positions[rank(bit)] = static_cast<uint32_t>(i);
+                            break;
+                        }
+                    }
+            });
+        }
+        
+        size_t count;
+        std::unique_ptr<T[]> data;
+        
+        std::vector<Level> levels;
+        std::unique_ptr<uint64_t[]> bits;
+        std::unique_ptr<size_t[]> samples;
+        std::unique_ptr<uint32_t[]> positions;
+        std::vector<size_t> fallback;
+        
+        Hash hashfn;
+        KeyEqual equal;
+    };
+    
+    /**
+     Create a FrozenSet from a Set, see FrozenSet.
+     @param s the set to freeze
+     @param threads the number of threads to use, 0 to use all the hardware threads
+     @returns the FrozenSet
+     */
+    template <typename T, typename F, size_t N, typename H, typename E, typename G>
+    FrozenSet<T, H, E> freeze(const Set<T, F, N, H, E, G>& s, unsigned threads = 0) {
+        return FrozenSet<T, H, E>(s, threads);
+    }
+}
+
+#endif
@@ -0,0 +1,133 @@
+//
+//  HyperLogLog.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_HyperLogLog_h
+#define Set_HyperLogLog_h
+
+#include <array>
+#include <cmath>
+
+#include "Utils.h"
+
+namespace set {
+    
+    using namespace utils;
+    
+    /**
+     Class that implement a HyperLogLog sketch, to estimate the number of distinct
+     elements of a stream in one pass and 2^P bytes, with a relative error of about
+     1.04 / sqrt(2^P), 1.6% with P = 12
+     (http://algo.inria.fr/flajolet/Publications/FlFuGaMe07.pdf).
+     Each element is hashed, the first P bits select a register that keeps the
+     longest run of leading zeros seen in the other bits.
+     The estimate is meant to presize a Set and its filter before the real ingest,
+     see Set::reserve_for_estimated.
+     
+     @param T the type of the elements
+     @param P the number of bits used to select the register
+     @param Hash the hash function
+     */
+    template <typename T, size_t P = 12, typename Hash = hasher<T>>
+    class HyperLogLog {
+        
+        static_assert(P >= 4 && P <= 18, "HyperLogLog needs 4 <= P <= 18");
+        
+        static constexpr size_t M = size_t(1) << P;
+    
+    public:
+        HyperLogLog() =default;
+        
+        /**
+         Constructor from generic iterators, adds all the elements.
+         @param begin first element of the iterator
+         @param end last element of the iterator
+         */
+        template <typename Iterator>
+        HyperLogLog(Iterator begin, Iterator end) {
+            for (; begin != end; begin++)
+                add(*begin);
+        }
+        
+        /**
+         Add an element to the sketch.
+         @param t the element
+         */
+        template <typename U>
+        void add(const U& t) {
+            auto h = static_hasher<uint64_t>::mix(hashfn(t));
+            auto rank = uint8_t(__builtin_clzll(h << P | uint64_t(1) << (P-1)) + 1);
+            auto& r = registers[h >> (64 - P)];
+            
+            r = std::max(r, rank);
+        }
+        
+        /**
+         Merge the other sketch into this one, the result is the sketch of the
+         union of the two streams.
+         @param other the sketch to merge
+         */
+        void merge(const HyperLogLog& other) {
+            for (size_t i=0; i < M; i++)
+                registers[i] = std::max(registers[i], other.registers[i]);
+        }
+        
+        /**
+         Estimate the number of distinct elements added, using linear counting
+         when the estimate is small and some registers are still empty.
+         @returns the estimate
+         */
+        size_t estimate() const {
+            double sum = 0;
+            size_t zeros = 0;
+            
+            for (auto r: registers) {
+                sum += std::ldexp(1.0, -r);
+                zeros += !r;
+            }
+            
+            auto alpha = 0.7213 / (1 + 1.079 / M);
+            auto e = alpha * M * M / sum;
+            
+            if (e <= 2.5 * M && zeros)
+                e = M * std::log(double(M) / zeros);
+            
+            return static_cast<size_t>(e + 0.5);
+        }
+    
+    private:
+        std::array<uint8_t, M> registers{};
+        
+        Hash hashfn;
+    };
+    
+    /**
+     Build the sketch of a range, in parallel: each thread builds the sketch
+     of a chunk and the sketches are merged.
+     @param begin first element of the range
+     @param end last element of the range
+     @param threads the number of threads to use, 0 to use all the hardware threads
+     @returns the sketch
+     */
+    template <typename Iterator,
+              typename T = typename std::iterator_traits<Iterator>::value_type>
+    HyperLogLog<T> sketch(Iterator begin, Iterator end, unsigned threads = 0) {
+        if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+        
+        std::vector<HyperLogLog<T>> partial(threads);
+        
+        parallel_for(end - begin, threads, [&](size_t b, size_t e, unsigned t) {
+            partial[t] = HyperLogLog<T>(begin + b, begin + e);
+        });
+        
+        for (size_t t=1; t < partial.size(); t++)
+            partial[0].merge(partial[t]);
+        
+        return partial[0];
+    }
+}
+
+#endif
@@ -0,0 +1,169 @@
+//
+//  IngestQueue.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_IngestQueue_h
+#define Set_IngestQueue_h
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Set.h"
+
+namespace set {
+    
+    /**
+     Class that implement an ingestion front end for a Set: many producer threads push
+     the elements in a bounded lock-free queue and the thread that owns the Set drains
+     it, inserting each batch with Set::insert_many, so that the filter is queried BATCH
+     elements at time and the buffer grows at most once per batch, while the Set keeps
+     a single writer and the producers never wait on a mutex.
+     The queue is a ring of cells with a sequence number each
+     (http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue):
+     a producer claims a cell with a compare and swap on the tail and publishes it by
+     advancing its sequence, the owner reads the cells in order.
+     Each element can carry a callback, called by the owner after the batch with true
+     if the element was new, or a future with the same result.
+     
+     @param T the type of the elements
+     @param S the Set to fill
+     @param CAPACITY the number of cells of the queue, must be a power of two
+     */
+    template <typename T, typename S = Set<T>, size_t CAPACITY = 1024>
+    class IngestQueue {
+        
+        static_assert(CAPACITY > 1 && (CAPACITY & (CAPACITY - 1)) == 0, "IngestQueue needs a power of two capacity");
+        
+        /**
+         Struct that rappresent a cell of the ring, it's free for the producer at position
+         p when sequence == p and full for the owner when sequence == p + 1.
+         */
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T t;
+            std::function<void(bool)> done;
+        };
+    
+    public:
+        /**
+         Constructor, the thread that owns the Set is the only one that can call drain.
+         @param set_ the Set to fill
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        IngestQueue(S& set_): set(set_), cells(new Cell[CAPACITY]) {
+            for (size_t i=0; i < CAPACITY; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            
+            keys.reserve(CAPACITY);
+            callbacks.reserve(CAPACITY);
+        }
+        
+        IngestQueue(const IngestQueue&) =delete;
+        IngestQueue& operator=(const IngestQueue&) =delete;
+        
+        /**
+         Push an element if the queue isn't full, from any thread.
+         @param t the element
+         @param done optional callback, called by the owner with true if the element was new
+         @returns true if pushed, false if the queue is full
+         */
+        bool try_push(const T& t, std::function<void(bool)> done = nullptr) {
+            auto pos = tail.load(std::memory_order_relaxed);
+            
+            for (;;) {
+                auto& cell = cells[pos & (CAPACITY - 1)];
+                auto diff = std::intptr_t(cell.sequence.load(std::memory_order_acquire)) - std::intptr_t(pos);
+                
+                if (diff < 0) return false;
+                
+                if (diff > 0) pos = tail.load(std::memory_order_relaxed);
+                else if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.t = t;
+                    cell.done = std::move(done);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    
+                    return true;
+                }
+            }
+        }
+        
+        /**
+         Push an element, from any thread, waiting while the queue is full, so it
+         must not be called by the owner.
+         @param t the element
+         @param done callback, called by the owner with true if the element was new
+         */
+        void push(const T& t, std::function<void(bool)> done) {
+            while (!try_push(t, done))
+                std::this_thread::yield();
+        }
+        
+        /**
+         Push an element, from any thread, see push.
+         @param t the element
+         @returns the future set by the owner with true if the element was new
+         */
+        std::future<bool> push(const T& t) {
+            auto promise = std::make_shared<std::promise<bool>>();
+            auto result = promise->get_future();
+            
+            push(t, [promise](bool inserted) { promise->set_value(inserted); });
+            
+            return result;
+        }
+        
+        /**
+         Insert the elements in the queue in the Set, at most CAPACITY of them in one
+         batch, then call their callbacks. Must be called only by the owner of the Set.
+         @returns the number of elements taken from the queue
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        size_t drain() {
+            keys.clear();
+            callbacks.clear();
+            
+            while (keys.size() < CAPACITY) {
+                auto& cell = cells[head & (CAPACITY - 1)];
+                if (cell.sequence.load(std::memory_order_acquire) != head + 1) break;
+                
+                keys.push_back(std::move(cell.t));
+                callbacks.push_back(std::move(cell.done));
+                
+                cell.done = nullptr;
+                cell.sequence.store(head + CAPACITY, std::memory_order_release);
+                head++;
+            }
+            
+            auto n = keys.size();
+            if (!n) return 0;
+            
+            uint64_t mask[(CAPACITY + 63) / 64];
+            set.insert_many(keys.data(), n, mask);
+            
+            for (size_t i=0; i < n; i++)
+                if (callbacks[i]) callbacks[i]((mask[i / 64] >> (i % 64)) & 1);
+            
+            return n;
+        }
+    
+    private:
+        S& set;
+        
+        std::unique_ptr<Cell[]> cells;
+        
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) size_t head = 0;
+        
+        std::vector<T> keys;
+        std::vector<std::function<void(bool)>> callbacks;
+    };
+}
+
+#endif
@@ -0,0 +1,497 @@
+//
+//  PersistentSet.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_PersistentSet_h
+#define Set_PersistentSet_h
+
+#include <array>
+#include <memory>
+
+#include "Set.h"
+
+namespace set {
+    
+    /**
+     Class that implement a Set-like structure with snapshots in O(1), ordered by insertion,
+     with random access in O(log n) and custom lookup filter.
+     The elements are stored in chunks of CHUNK elements, reached through a persistent
+     trie of FANOUT-way nodes, and the filter is split in SHARDS filters by the hash of
+     the elements. The nodes, the chunks and the shards are shared between a PersistentSet
+     and its copies, and a mutation copies only what it touches and is still shared:
+     the nodes on the path to the chunk, the chunk and the shard of the element, so a
+     snapshot never changes and an insertion after a snapshot copies O(log n) nodes,
+     CHUNK elements and 1/SHARDS of the filter.
+     Snapshots can be read from different threads, the filters that modify themselves
+     on query, like AdaptiveFilter, can't be used.
+     
+     @param T the type of the values inside the Set
+     @param F the filter of each shard, must be copy constructible
+     @param CHUNK the number of elements in each chunk
+     @param Hash the hash function, the filter should use the same
+     @param KeyEqual the equality used to compare the elements
+     @param SHARDS the number of shards of the filter
+     */
+    template <typename T,
+              typename F = BaseFilter<T>,
+              size_t CHUNK = 64,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>,
+              size_t SHARDS = 64>
+    class PersistentSet {
+        
+        static_assert(std::is_copy_constructible<F>::value, "PersistentSet needs a copyable filter");
+        static_assert(!mutating_query<F>::value, "PersistentSet needs a filter that isn't modified by query");
+        
+        static constexpr size_t BITS = 5;
+        static constexpr size_t FANOUT = size_t(1) << BITS;
+        
+        /**
+         Struct that rappresent a chunk of elements.
+         */
+        struct Chunk {
+            T items[CHUNK];
+        };
+        
+        /**
+         Struct that rappresent a node of the trie, the nodes of the lowest level
+         point to the chunks, the others to the nodes below.
+         */
+        struct Node {
+            std::array<std::shared_ptr<Node>, FANOUT> children;
+            std::array<std::shared_ptr<Chunk>, FANOUT> chunks;
+        };
+        
+        /**
+         Random access iterator over the elements of the chunks.
+         */
+        class _iterator {
+        
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = const T;
+            using difference_type   = ptrdiff_t;
+            using pointer           = value_type*;
+            using reference         = value_type&;
+            
+            /**
+             Dereference operator
+             @returns the current element
+             */
+            reference operator*() const {
+                return (*set)[index];
+            }
+            
+            /**
+             Return pointer
+             @returns pointer to the current element
+             */
+            pointer operator->() const {
+                return &(*set)[index];
+            }
+            
+            /**
+             Pre-increment operator;
+             @returns _iterator incremented;
+             */
+            _iterator& operator++() {
+                ++index;
+                return *this;
+            }
+            
+            /**
+             Post-increment operator;
+             @returns _iterator not incremented;
+             */
+            _iterator operator++(int) {
+                return _iterator(set, index++);
+            }
+            
+            /**
+             Pre-decrement operator;
+             @returns _iterator decremented;
+             */
+            _iterator& operator--() {
+                --index;
+                return *this;
+            }
+            
+            /**
+             Post-decrement operator;
+             @returns _iterator not decremented;
+             */
+            _iterator operator--(int) {
+                return _iterator(set, index--);
+            }
+            
+            /**
+             Advance operator;
+             @param offset how much to advance
+             @returns _iterator advanced by offset;
+             */
+            _iterator operator+(difference_type offset) const {
+                return _iterator(set, index + offset);
+            }
+            
+            /**
+             Recede operator;
+             @param offset how much to recede
+             @returns _iterator receded by offset;
+             */
+            _iterator operator-(difference_type offset) const {
+                return _iterator(set, index - offset);
+            }
+            
+            /**
+             Difference operator;
+             @param other reference to the other _iterator
+             @returns how many elements between this and other _iterator
+             */
+            difference_type operator-(const _iterator& other) const {
+                return difference_type(index) - difference_type(other.index);
+            }
+            
+            bool operator==(const _iterator& other) const {
+                return index == other.index && set == other.set;
+            }
+            
+            bool operator!=(const _iterator& other) const {
+                return index != other.index || set != other.set;
+            }
+        
+        private:
+            const PersistentSet* set;
+            size_t index;
+            
+            friend class PersistentSet;
+            
+            _iterator(const PersistentSet* set_, size_t index_): set(set_), index(index_) {}
+        };
+    
+    public:
+        using const_iterator = _iterator;
+        
+        /**
+         Constructor, creates an empty Set.
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        PersistentSet(): root(std::make_shared<Node>()) {}
+        
+        /**
+         Constructor from generic iterators, the duplicates are skipped.
+         @param begin first element of the iterator
+         @param end last element of the iterator
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        PersistentSet(Iterator begin, Iterator end): PersistentSet() {
+            for (; begin != end; begin++)
+                try {
+                    insert(*begin);
+                } catch (exceptions::already_in) {
+                
+                }
+        }
+        
+        /**
+         Copy constructor, shares the trie and the shards of the filter with the other Set in O(1).
+         */
+        PersistentSet(const PersistentSet&) =default;
+        PersistentSet& operator=(const PersistentSet&) =default;
+        
+        /**
+         Take a snapshot of the Set in O(1), the snapshot doesn't see the mutations
+         made to the Set after it and the Set doesn't see the ones made to the snapshot.
+         @returns the snapshot
+         */
+        PersistentSet snapshot() const {
+            return *this;
+        }
+        
+        /**
+         Subscribe operator to access element by index, walking the trie in O(log n)
+         @param p the index of the element to retrieve
+         @returns const reference to the element
+         */
+        const T& operator[](size_t p) const {
+            return chunk(p / CHUNK)->items[p % CHUNK];
+        }
+        
+        /**
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        size_t size() const {
+            return count;
+        }
+        
+        /**
+         Insert an element into the Set, the filter is queried first and the elements
+         are scanned only if it returns MAYBE. Copies the last chunk, the nodes above
+         it and the shard of the element if they're shared.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        void insert(const T& t) {
+            push(t);
+        }
+        
+        /**
+         Insert an element moving it into the Set, see insert.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        void insert(T&& t) {
+            push(std::move(t));
+        }
+        
+        /**
+         Remove an element from the Set keeping the order of the others, the chunks
+         from the one of the element to the last are copied if they're shared.
+         @param t the element
+         @exception not_found() if the element is not found in the Set.
+         */
+        template <typename U>
+        void remove(const U& t) {
+            if (query(t) == Query::NOT_FOUND)
+                throw exceptions::not_found();
+            
+            auto i = find(t);
+            if (i == -1)
+                throw exceptions::not_found();
+            
+            checker(shard(t)).remove(t);
+            
+            for (auto j = size_t(i); j+1 < count; j++)
+                at(j) = std::move(at(j+1));
+            
+            if (--count % CHUNK == 0)
+                leaf(count / CHUNK).reset();
+            else
+                at(count) = T();
+        }
+        
+        /**
+         Check if an element is in the Set, the filter is queried first and the
+         elements are scanned only if it returns MAYBE.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        template <typename U>
+        bool contains(const U& t) const {
+            auto res = query(t);
+            if (res != Query::MAYBE) return res == Query::FOUND;
+            
+            return find(t) != -1;
+        }
+        
+        /**
+         Check if two Sets share the chunk of the element at index p.
+         @param other the other Set
+         @param p the index of the element
+         @returns true if the chunk is shared, false if p is outside one of them
+         */
+        bool shares(const PersistentSet& other, size_t p) const {
+            return p < count && p < other.count && chunk(p / CHUNK) == other.chunk(p / CHUNK);
+        }
+        
+        /**
+         Check if two Sets share the shard of the filter of an element.
+         @param other the other Set
+         @param t the element
+         @returns true if the shard is shared
+         */
+        template <typename U>
+        bool shares_filter(const PersistentSet& other, const U& t) const {
+            return filters[shard(t)] == other.filters[shard(t)];
+        }
+        
+        /**
+         Return the const_iterator, pointing at the first element
+         @returns the const_iterator
+         */
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        
+        /**
+         Return the const_iterator, pointing at the element after the last
+         @returns the const_iterator
+         */
+        const_iterator end() const {
+            return const_iterator(this, count);
+        }
+    
+    private:
+        /**
+         Insert the element, see insert.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        template <typename U>
+        void push(U&& t) {
+            auto res = query(t);
+            
+            if (res == Query::FOUND || (res == Query::MAYBE && find(t) != -1))
+                throw exceptions::already_in();
+            
+            checker(shard(t)).add(t);
+            
+            if (count % CHUNK == 0) {
+                if (count / CHUNK >> (BITS * height)) {
+                    auto node = std::make_shared<Node>();
+                    node->children[0] = std::move(root);
+                    
+                    root = std::move(node);
+                    height++;
+                }
+                
+                leaf(count / CHUNK) = std::make_shared<Chunk>();
+            }
+            
+            at(count++) = std::forward<U>(t);
+        }
+        
+        /**
+         Linear search of the element, one chunk at time.
+         @param t the element
+         @returns the index of the element, -1 if not found
+         */
+        template <typename U>
+        long find(const U& t) const {
+            for (size_t c=0; c*CHUNK < count; c++) {
+                auto n = int(std::min(CHUNK, count - c*CHUNK));
+                auto i = find_linear(chunk(c)->items, n, t, equal);
+                
+                if (i != -1) return long(c*CHUNK + i);
+            }
+            
+            return -1;
+        }
+        
+        /**
+         Return the chunk c, walking the trie from the root.
+         @param c the index of the chunk
+         @returns pointer to the chunk
+         */
+        const std::shared_ptr<Chunk>& chunk(size_t c) const {
+            auto node = root.get();
+            
+            for (auto level = height-1; level > 0; level--)
+                node = node->children[(c >> (BITS * level)) & (FANOUT-1)].get();
+            
+            return node->chunks[c & (FANOUT-1)];
+        }
+        
+        /**
+         Return the pointer to the chunk c to write it, copying the nodes on the path
+         that are shared and creating the missing ones.
+         @param c the index of the chunk
+         @returns reference to the pointer to the chunk
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        std::shared_ptr<Chunk>& leaf(size_t c) {
+            auto node = own(root);
+            
+            for (auto level = height-1; level > 0; level--)
+                node = own(node->children[(c >> (BITS * level)) & (FANOUT-1)]);
+            
+            return node->chunks[c & (FANOUT-1)];
+        }
+        
+        /**
+         Make a node of the trie writable, copying it if it's shared or creating it if missing.
+         @param node the pointer to the node
+         @returns pointer to the node
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        static Node* own(std::shared_ptr<Node>& node) {
+            if (!node) node = std::make_shared<Node>();
+            else if (node.use_count() > 1) node = std::make_shared<Node>(*node);
+            
+            return node.get();
+        }
+        
+        /**
+         Return the element at index p to write it, copying its chunk first if it's shared.
+         @param p the index of the element
+         @returns reference to the element
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        T& at(size_t p) {
+            auto& chunk = leaf(p / CHUNK);
+            
+            if (chunk.use_count() > 1)
+                chunk = std::make_shared<Chunk>(*chunk);
+            
+            return chunk->items[p % CHUNK];
+        }
+        
+        /**
+         Return the shard of the filter of an element, from the high bits of its hash
+         so that the elements of a shard don't share the bits used by the filter.
+         @param t the element
+         @returns the index of the shard
+         */
+        template <typename U>
+        size_t shard(const U& t) const {
+            return size_t((uint64_t(hashfn(t)) * 0x9e3779b97f4a7c15ull) >> 32) % SHARDS;
+        }
+        
+        /**
+         Query the shard of the filter of an element, a shard never created means
+         that no element hashed to it.
+         @param t the element
+         @returns Query query result
+         */
+        template <typename U>
+        Query query(const U& t) const {
+            auto& f = filters[shard(t)];
+            
+            return f ? f->query(t) : Query::NOT_FOUND;
+        }
+        
+        /**
+         Return a shard of the filter to modify it, copying it first if it's shared.
+         @param s the index of the shard
+         @returns reference to the filter
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        F& checker(size_t s) {
+            auto& f = filters[s];
+            
+            if (!f) f = std::make_shared<F>();
+            else if (f.use_count() > 1) f = std::make_shared<F>(*f);
+            
+            return *f;
+        }
+        
+        /**
+         Comodity function to easily display the content of a Set.
+         @param os stream to write on
+         @param set reference of the set to write
+         @return output stream
+         */
+        friend std::ostream& operator<<(std::ostream &os, const PersistentSet &set) {
+            for (const auto& e: set) {
+                os << e << " ";
+            }
+            
+            return os;
+        }
+        
+        size_t count = 0;
+        size_t height = 1;
+        
+        std::shared_ptr<Node> root;
+        std::array<std::shared_ptr<F>, SHARDS> filters;
+        
+        Hash hashfn;
+        KeyEqual equal;
+    };
+}
+
+#endif
@@ -0,0 +1,756 @@
+//
+//  Roaring.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_Roaring_h
+#define Set_Roaring_h
+
+#include <vector>
+#include <iterator>
+
+#include "Exceptions.h"
+#include "Utils.h"
+
+namespace set {
+    
+    using namespace utils;
+    
+    namespace roaring {
+        
+        /**
+         Class that rappresent the 16 low bits of the elements that share the same 16+ high
+         bits, stored as a sorted array while they are sparse, as a bitmap of 2^16 bits when
+         there are more than ARRAY_MAX, or as a list of runs after optimize() if it's smaller.
+         Based on Roaring Bitmaps (https://arxiv.org/abs/1603.06549).
+         */
+        class Container {
+        
+        public:
+            static constexpr uint32_t ARRAY_MAX = 4096;
+            static constexpr uint32_t WORDS = 1024;
+            static constexpr uint32_t END = 1 << 16;
+            
+            /**
+             Enumerator class to rappresent the kind of container
+             */
+            enum class Kind { ARRAY, BITMAP, RUN };
+            
+            /**
+             Check if the value is in the container.
+             @param v the value
+             @returns true if found
+             */
+            bool contains(uint16_t v) const {
+                if (kind == Kind::BITMAP) return bitmap[v >> 6] >> (v & 63) & 1;
+                if (kind == Kind::ARRAY) return std::binary_search(array.begin(), array.end(), v);
+                
+                auto r = run_of(v);
+                return r != runs.size() && runs[r].first <= v;
+            }
+            
+            /**
+             Add the value to the container, moving to a bitmap if the array gets too big.
+             @param v the value
+             @returns true if the value wasn't in the container
+             */
+            bool add(uint16_t v) {
+                if (kind == Kind::RUN) unrun();
+                
+                if (kind == Kind::ARRAY) {
+                    auto it = std::lower_bound(array.begin(), array.end(), v);
+                    if (it != array.end() && *it == v) return false;
+                    
+                    if (cardinality < ARRAY_MAX) array.insert(it, v);
+                    else {
+                        to_bitmap();
+                        bitmap[v >> 6] |= uint64_t(1) << (v & 63);
+                    }
+                } else {
+                    auto& w = bitmap[v >> 6];
+                    auto mask = uint64_t(1) << (v & 63);
+                    if (w & mask) return false;
+                    
+                    w |= mask;
+                }
+                
+                cardinality++;
+                return true;
+            }
+            
+            /**
+             Remove the value from the container, moving to an array if the bitmap gets sparse.
+             @param v the value
+             @returns true if the value was in the container
+             */
+            bool remove(uint16_t v) {
+                if (kind == Kind::RUN) unrun();
+                
+                if (kind == Kind::ARRAY) {
+                    auto it = std::lower_bound(array.begin(), array.end(), v);
+                    if (it == array.end() || *it != v) return false;
+                    
+                    array.erase(it);
+                } else {
+                    auto& w = bitmap[v >> 6];
+                    auto mask = uint64_t(1) << (v & 63);
+                    if (!(w & mask)) return false;
+                    
+                    w &= ~mask;
+                }
+                
+                if (--cardinality <= ARRAY_MAX && kind == Kind::BITMAP) to_array();
+                return true;
+            }
+            
+            /**
+             Return the smallest value >= v in the container.
+             @param v the value to start from
+             @returns the next value, END if there isn't one
+             */
+            uint32_t next(uint32_t v) const {
+                if (v >= END) return END;
+                
+                if (kind == Kind::ARRAY) {
+                    auto it = std::lower_bound(array.begin(), array.end(), v);
+                    return it == array.end() ? END : *it;
+                }
+                
+                if (kind == Kind::RUN) {
+                    auto r = run_of(static_cast<uint16_t>(v));
+                    if (r == runs.size()) return END;
+                    
+                    return std::max<uint32_t>(v, runs[r].first);
+                }
+                
+                auto w = v >> 6;
+                auto word = bitmap[w] & (~uint64_t(0) << (v & 63));
+                
+                while (!word) {
+                    if (++w == WORDS) return END;
+                    word = bitmap[w];
+                }
+                
+                return w * 64 + __builtin_ctzll(word);
+            }
+            
+            /**
+             Switch to the smallest rappresentation among array, bitmap and runs.
+             */
+            void optimize() {
+                if (kind == Kind::RUN) unrun();
+                
+                size_t count = 0;
+                for (auto v = next(0); v != END; ) {
+                    auto e = v;
+                    while (e+1 < END && contains(static_cast<uint16_t>(e+1))) e++;
+                    
+                    count++;
+                    v = next(e+1);
+                }
+                
+                auto size = kind == Kind::ARRAY ? cardinality * 2 : WORDS * 8;
+                if (count * 4 < size) to_runs();
+            }
+            
+            /**
+             Return the number of values in the container.
+             @returns the cardinality
+             */
+            uint32_t size() const {
+                return cardinality;
+            }
+            
+            /**
+             Return the memory used by the values of the container.
+             @returns the size in bytes
+             */
+            size_t bytes() const {
+                return array.capacity() * 2 + bitmap.capacity() * 8 + runs.capacity() * 4;
+            }
+            
+            /**
+             Union of two containers, word by word if one of them is a bitmap.
+             @param a the first container
+             @param b the second container
+             @returns the new container
+             */
+            friend Container operator|(const Container& a, const Container& b) {
+                Container c;
+                
+                if (a.kind == Kind::ARRAY && b.kind == Kind::ARRAY && a.cardinality + b.cardinality <= ARRAY_MAX) {
+                    std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                   std::back_inserter(c.array));
+                    
+                    c.cardinality = static_cast<uint32_t>(c.array.size());
+                    return c;
+                }
+                
+                c.bitmap = a.words();
+                c.kind = Kind::BITMAP;
+                
+                if (b.kind == Kind::ARRAY) {
+                    for (auto v: b.array)
+                        c.bitmap[v >> 6] |= uint64_t(1) << (v & 63);
+                } else {
+                    auto w = b.words();
+                    for (uint32_t i=0; i < WORDS; i++)
+                        c.bitmap[i] |= w[i];
+                }
+                
+                c.recount();
+                return c;
+            }
+            
+            /**
+             Intersection of two containers, word by word if both of them are bitmaps,
+             filtering the array otherwise.
+             @param a the first container
+             @param b the second container
+             @returns the new container
+             */
+            friend Container operator&(const Container& a, const Container& b) {
+                Container c;
+                
+                if (a.kind == Kind::ARRAY || b.kind == Kind::ARRAY) {
+                    auto& small = a.kind == Kind::ARRAY ? a : b;
+                    auto& other = a.kind == Kind::ARRAY ? b : a;
+                    
+                    for (auto v: small.array)
+                        if (other.contains(v)) c.array.push_back(v);
+                    
+                    c.cardinality = static_cast<uint32_t>(c.array.size());
+                    return c;
+                }
+                
+                c.bitmap = a.words();
+                c.kind = Kind::BITMAP;
+                
+                auto w = b.words();
+                for (uint32_t i=0; i < WORDS; i++)
+                    c.bitmap[i] &= w[i];
+                
+                c.recount();
+                return c;
+            }
+            
+            /**
+             Create a new container without the values that pass the predicate, bitmaps
+             are filtered one word at time visiting only the bits set.
+             @param c the container to filter
+             @param p the predicate, called with the 16 low bits
+             @returns the new container
+             */
+            template <typename P>
+            friend Container filter_out(const Container& c, P p) {
+                Container n;
+                
+                if (c.kind == Kind::ARRAY) {
+                    std::copy_if(c.array.begin(), c.array.end(), std::back_inserter(n.array),
+                                 [&](uint16_t v) { return !p(v); });
+                    
+                    n.cardinality = static_cast<uint32_t>(n.array.size());
+                    return n;
+                }
+                
+                n.bitmap = c.words();
+                n.kind = Kind::BITMAP;
+                
+                for (uint32_t i=0; i < WORDS; i++)
+                    for (auto word = n.bitmap[i]; word; word &= word - 1) {
+                        auto b = __builtin_ctzll(word);
+                        if (p(static_cast<uint16_t>(i * 64 + b))) n.bitmap[i] &= ~(uint64_t(1) << b);
+                    }
+                
+                n.recount();
+                return n;
+            }
+        
+        private:
+            /**
+             Return the index of the first run that ends at or after v.
+             @param v the value
+             @returns the index of the run
+             */
+            size_t run_of(uint16_t v) const {
+                auto it = std::lower_bound(runs.begin(), runs.end(), v,
+                                           [](const std::pair<uint16_t, uint16_t>& r, uint16_t v) {
+                                               return r.first + r.second < v;
+                                           });
+                
+                return it - runs.begin();
+            }
+            
+            /**
+             Return the values as a bitmap of WORDS words.
+             @returns the bitmap
+             */
+            std::vector<uint64_t> words() const {
+                if (kind == Kind::BITMAP) return bitmap;
+                
+                std::vector<uint64_t> w(WORDS);
+                if (kind == Kind::ARRAY) {
+                    for (auto v: array)
+                        w[v >> 6] |= uint64_t(1) << (v & 63);
+                } else {
+                    for (auto& r: runs)
+                        for (uint32_t v = r.first; v <= uint32_t(r.first) + r.second; v++)
+                            w[v >> 6] |= uint64_t(1) << (v & 63);
+                }
+                
+                return w;
+            }
+            
+            /**
+             Count the bits of the bitmap and move to an array if it's sparse.
+             */
+            void recount() {
+                cardinality = 0;
+                for (auto w: bitmap)
+                    cardinality += __builtin_popcountll(w);
+                
+                if (cardinality <= ARRAY_MAX) to_array();
+            }
+            
+            void to_bitmap() {
+                bitmap = words();
+                array = std::vector<uint16_t>();
+                runs = std::vector<std::pair<uint16_t, uint16_t>>();
+                kind = Kind::BITMAP;
+            }
+            
+            void to_array() {
+                std::vector<uint16_t> a;
+                a.reserve(cardinality);
+                
+                for (auto v = next(0); v != END; v = next(v+1))
+                    a.push_back(static_cast<uint16_t>(v));
+                
+                array.swap(a);
+                bitmap = std::vector<uint64_t>();
+                runs = std::vector<std::pair<uint16_t, uint16_t>>();
+                kind = Kind::ARRAY;
+            }
+            
+            void to_runs() {
+                std::vector<std::pair<uint16_t, uint16_t>> r;
+                
+                for (auto v = next(0); v != END; ) {
+                    auto e = v;
+                    while (e+1 < END && contains(static_cast<uint16_t>(e+1))) e++;
+                    
+                    r.push_back({static_cast<uint16_t>(v), static_cast<uint16_t>(e - v)});
+                    v = next(e+1);
+                }
+                
+                runs.swap(r);
+                array = std::vector<uint16_t>();
+                bitmap = std::vector<uint64_t>();
+                kind = Kind::RUN;
+            }
+            
+            void unrun() {
+                if (cardinality > ARRAY_MAX) to_bitmap();
+                else to_array();
+            }
+            
+            Kind kind = Kind::ARRAY;
+            uint32_t cardinality = 0;
+            
+            std::vector<uint16_t> array;
+            std::vector<uint64_t> bitmap;
+            std::vector<std::pair<uint16_t, uint16_t>> runs;
+        };
+    }
+    
+    /**
+     Class that implement an unordered Set of integers, split in chunks of 2^16
+     values by the high bits, each chunk stored in the smallest roaring container.
+     Union, intersection and filter_out work chunk by chunk, word by word on the bitmaps.
+     Use a Set with a RoaringFilter if the insertion order is needed.
+     
+     @param T the integral type of the values inside the Set
+     */
+    template <typename T>
+    class Roaring {
+        
+        static_assert(std::is_integral<T>::value, "Roaring needs an integral type");
+        
+        using U = typename std::make_unsigned<T>::type;
+        using Container = roaring::Container;
+        
+        static constexpr U SIGN = std::is_signed<T>::value ? U(U(1) << (sizeof(T) * 8 - 1)) : U(0);
+        
+        /**
+         Iterator that visits the values in ascending order
+         */
+        class _iterator {
+        
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = T;
+            using difference_type   = ptrdiff_t;
+            using pointer           = const T*;
+            using reference         = T;
+            
+            /**
+             Dereference operator
+             @returns the current value
+             */
+            T operator*() const {
+                return decode(r->keys[c], v);
+            }
+            
+            /**
+             Pre-increment operator;
+             @returns _iterator incremented;
+             */
+            _iterator& operator++() {
+                v = r->containers[c].next(v+1);
+                skip();
+                
+                return *this;
+            }
+            
+            /**
+             Post-increment operator;
+             @returns _iterator not incremented;
+             */
+            _iterator operator++(int) {
+                auto it = *this;
+                ++*this;
+                
+                return it;
+            }
+            
+            bool operator==(const _iterator& other) const {
+                return c == other.c && v == other.v;
+            }
+            
+            bool operator!=(const _iterator& other) const {
+                return !(*this == other);
+            }
+        
+        private:
+            const Roaring* r;
+            size_t c;
+            uint32_t v;
+            
+            friend class Roaring;
+            
+            _iterator(const Roaring* r_, size_t c_): r(r_), c(c_), v(0) {
+                if (c < r->keys.size()) v = r->containers[c].next(0);
+                skip();
+            }
+            
+            void skip() {
+                while (c < r->keys.size() && v == Container::END)
+                    if (++c < r->keys.size()) v = r->containers[c].next(0);
+                
+                if (c == r->keys.size()) v = 0;
+            }
+        };
+    
+    public:
+        using const_iterator = _iterator;
+        
+        /**
+         Constructor
+         */
+        Roaring() =default;
+        
+        /**
+         Constructor from generic iterators, duplicates are ignored.
+         @param begin first element of the iterator
+         @param end last element of the iterator
+         */
+        template <typename Iterator>
+        Roaring(Iterator begin, Iterator end) {
+            for (; begin != end; begin++)
+                add(static_cast<T>(*begin));
+        }
+        
+        /**
+         Insert an element.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        void insert(T t) {
+            if (!add(t))
+                throw exceptions::already_in();
+        }
+        
+        /**
+         Remove an element.
+         @param t the element
+         @exception not_found() if the element is not found in the Set.
+         */
+        void remove(T t) {
+            if (!erase(t))
+                throw exceptions::not_found();
+        }
+        
+        /**
+         Insert an element if not present.
+         @param t the element
+         @returns true if the element was inserted
+         */
+        bool add(T t) {
+            auto u = encode(t);
+            auto i = find(high(u));
+            
+            if (i == keys.size() || keys[i] != high(u)) {
+                keys.insert(keys.begin() + i, high(u));
+                containers.insert(containers.begin() + i, Container());
+            }
+            
+            if (!containers[i].add(low(u))) return false;
+            
+            count++;
+            return true;
+        }
+        
+        /**
+         Remove an element if present.
+         @param t the element
+         @returns true if the element was removed
+         */
+        bool erase(T t) {
+            auto u = encode(t);
+            auto i = find(high(u));
+            
+            if (i == keys.size() || keys[i] != high(u) || !containers[i].remove(low(u)))
+                return false;
+            
+            if (!containers[i].size()) {
+                keys.erase(keys.begin() + i);
+                containers.erase(containers.begin() + i);
+            }
+            
+            count--;
+            return true;
+        }
+        
+        /**
+         Check if an element is in the Set.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        bool contains(T t) const {
+            auto u = encode(t);
+            auto i = find(high(u));
+            
+            return i != keys.size() && keys[i] == high(u) && containers[i].contains(low(u));
+        }
+        
+        /**
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        size_t size() const {
+            return count;
+        }
+        
+        /**
+         Memory used by the containers.
+         @returns the size in bytes
+         */
+        size_t bytes() const {
+            size_t b = keys.capacity() * sizeof(U) + containers.capacity() * sizeof(Container);
+            for (auto& c: containers)
+                b += c.bytes();
+            
+            return b;
+        }
+        
+        /**
+         Convert every container to its smallest rappresentation, using runs where they pay off.
+         */
+        void optimize() {
+            for (auto& c: containers)
+                c.optimize();
+        }
+        
+        /**
+         Return the const_iterator, pointing at the smallest element
+         @returns the const_iterator
+         */
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        
+        /**
+         Return the const_iterator, pointing after the largest element
+         @returns the const_iterator
+         */
+        const_iterator end() const {
+            return const_iterator(this, keys.size());
+        }
+        
+        /**
+         Union of two Sets, merging the chunks by key.
+         @param a the first Set
+         @param b the second Set
+         @returns the new Set
+         */
+        friend Roaring operator|(const Roaring& a, const Roaring& b) {
+            Roaring n;
+            size_t i = 0, j = 0;
+            
+            while (i < a.keys.size() || j < b.keys.size()) {
+                if (j == b.keys.size() || (i < a.keys.size() && a.keys[i] < b.keys[j])) {
+                    n.append(a.keys[i], a.containers[i]);
+                    i++;
+                } else if (i == a.keys.size() || b.keys[j] < a.keys[i]) {
+                    n.append(b.keys[j], b.containers[j]);
+                    j++;
+                } else {
+                    n.append(a.keys[i], a.containers[i] | b.containers[j]);
+                    i++, j++;
+                }
+            }
+            
+            return n;
+        }
+        
+        /**
+         Intersection of two Sets, only the chunks with the same key are intersected.
+         @param a the first Set
+         @param b the second Set
+         @returns the new Set
+         */
+        friend Roaring operator&(const Roaring& a, const Roaring& b) {
+            Roaring n;
+            size_t i = 0, j = 0;
+            
+            while (i < a.keys.size() && j < b.keys.size()) {
+                if (a.keys[i] < b.keys[j]) i++;
+                else if (b.keys[j] < a.keys[i]) j++;
+                else {
+                    n.append(a.keys[i], a.containers[i] & b.containers[j]);
+                    i++, j++;
+                }
+            }
+            
+            return n;
+        }
+        
+        /**
+         Create a new Set from a Set filtering out the elements that pass the
+         predicate function passed, chunk by chunk.
+         @param s the set to filter out
+         @param p the function or lambda to use to filter the elements
+         @returns the new Set
+         */
+        template <typename P>
+        friend Roaring filter_out(const Roaring& s, P p) {
+            Roaring n;
+            
+            for (size_t i=0; i < s.keys.size(); i++) {
+                auto key = s.keys[i];
+                n.append(key, filter_out(s.containers[i], [&](uint16_t v) { return p(decode(key, v)); }));
+            }
+            
+            return n;
+        }
+        
+        /**
+         Comodity function to easily display the content of a Set.
+         @param os stream to write on
+         @param set reference of the set to write
+         @return output stream
+         */
+        friend std::ostream& operator<<(std::ostream &os, const Roaring &set) {
+            for (auto e: set)
+                os << e << " ";
+            
+            return os;
+        }
+    
+    private:
+        static U encode(T t) {
+            return static_cast<U>(t) ^ SIGN;
+        }
+        
+        static T decode(U key, uint32_t v) {
+            return static_cast<T>(static_cast<U>(static_cast<U>(key << 8 << 8) | v) ^ SIGN);
+        }
+        
+        static U high(U u) {
+            return static_cast<U>(u >> 8 >> 8);
+        }
+        
+        static uint16_t low(U u) {
+            return static_cast<uint16_t>(u & 0xFFFF);
+        }
+        
+        /**
+         Binary search of the chunk with the key.
+         @param key the high bits
+         @returns the index of the first chunk with key >= key
+         */
+        size_t find(U key) const {
+            return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        }
+        
+        /**
+         Append a chunk, used to build the result of the set operations, the
+         empty chunks are dropped.
+         @param key the high bits
+         @param c the container
+         */
+        void append(U key, Container c) {
+            if (!c.size()) return;
+            
+            count += c.size();
+            keys.push_back(key);
+            containers.push_back(std::move(c));
+        }
+        
+        std::vector<U> keys;
+        std::vector<Container> containers;
+        size_t count = 0;
+    };
+    
+    namespace filters {
+        
+        /**
+         Class that implements an exact filter for integral types using a Roaring Set,
+         the Set keeps the insertion order while the filter answers FOUND or NOT_FOUND
+         with a few bits per element on dense values.
+         */
+        template <typename T>
+        class RoaringFilter {
+        
+        public:
+            void add(const T& t) {
+                bits.add(t);
+            }
+            
+            template <typename U>
+            Query query(const U& t) {
+                return bits.contains(static_cast<T>(t)) ? Query::FOUND : Query::NOT_FOUND;
+            }
+            
+            template <typename U>
+            void remove(const U& t) {
+                bits.erase(static_cast<T>(t));
+            }
+            
+            /**
+             Memory used by the filter.
+             @returns the size in bytes
+             */
+            size_t bytes() const {
+                return sizeof(*this) + bits.bytes();
+            }
+        
+        private:
+            Roaring<T> bits;
+        };
+    }
+}
+
+#endif
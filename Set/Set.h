@@ -11,52 +11,110 @@
 
 #include <iostream>
 #include <cassert>
+#include <numeric>
+#include <span>
 
 #include "Exceptions.h"
 #include "Utils.h"
+#include "Buffer.h"
 #include "Filters.h"
 
 namespace set {
     
     using namespace filters;
     
+    /**
+     Growth policy of the heap buffer of a Set: when it's full the capacity is multiplied
+     by NUM / DEN, when the elements drop below 1 / SHRINK of the capacity it's divided by
+     the same factor, and it never goes below MIN. With NUM < SHRINK * DEN a shrunk buffer
+     is still far from full, so a workload that alternates insertions and removals around
+     a threshold doesn't reallocate on every operation. SHRINK = 0 never shrinks.
+     
+     @param NUM the numerator of the growth factor
+     @param DEN the denominator of the growth factor
+     @param SHRINK the fraction of the capacity below which the buffer shrinks
+     @param MIN the minimum capacity of the heap buffer
+     */
+    template <size_t NUM = 2, size_t DEN = 1, size_t SHRINK = 4, size_t MIN = 0>
+    struct GrowthPolicy {
+        
+        static_assert(NUM > DEN, "GrowthPolicy needs a growth factor greater than one");
+        
+        /**
+         Capacity after the buffer is full.
+         @param capacity the current capacity
+         @returns the new capacity
+         */
+        static size_t grow(size_t capacity) {
+            return std::max({MIN, capacity + 1, capacity * NUM / DEN});
+        }
+        
+        /**
+         Check if the buffer has to shrink.
+         @param size the number of elements
+         @param capacity the current capacity
+         @returns true if it has to shrink
+         */
+        static bool shrinks(size_t size, size_t capacity) {
+            return SHRINK && capacity > MIN && size * SHRINK < capacity;
+        }
+        
+        /**
+         Capacity after the buffer shrinks, never less than the elements.
+         @param size the number of elements
+         @param capacity the current capacity
+         @returns the new capacity
+         */
+        static size_t shrink(size_t size, size_t capacity) {
+            return std::max({MIN, size, capacity * DEN / NUM});
+        }
+    };
+    
+    using NeverShrink = GrowthPolicy<2, 1, 0>;
+    
     /**
      Class that implement a Set-like structure, with random access in O(1), orderer insertion,
      and custom lookup filter.
+     The filter is built lazily, by the first method that modifies the Set after the elements
+     move to the heap, and it's rebuilt only by those methods: until then the const lookups
+     scan the elements, so concurrent const lookups never write the filter and don't race
+     on it, unless the filter updates its state on query, like the AdaptiveFilter: then even
+     the const lookups need external synchronization.
      
      @param T the type of the values inside the Set
      @param F the filter to use, defaulted to BloomFilter
+     @param N the number of elements kept inline before moving to the heap and using the filter
+     @param Hash the hash function, the filter should use the same
+     @param KeyEqual the equality used to compare the elements
+     @param Growth the growth policy of the heap buffer, see GrowthPolicy
      */
-    template <typename T, typename F = BaseFilter<T>>
+    template <typename T,
+              typename F = BaseFilter<T>,
+              size_t N = 16,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>,
+              typename Growth = GrowthPolicy<>>
     class Set {
         
         template <bool is_const = true>
         class _iterator {
             //
         public:
-            using iterator_category = std::random_access_iterator_tag ;
-            using value_type        = typename std::conditional<is_const, const T, T>::type;
+            using iterator_concept  = std::contiguous_iterator_tag;
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = T;
             using difference_type   = ptrdiff_t;
-            using pointer           = value_type*;
-            using reference         = value_type&;
-            /**
-             Copy constructor
-             @param other reference to the _iterator to copy.
-             */
-            _iterator(const _iterator &other) {
-                base = other.base;
-                data = other.data;
-            }
+            using pointer           = typename std::conditional<is_const, const T, T>::type*;
+            using reference         = typename std::conditional<is_const, const T, T>::type&;
+            
+            _iterator() =default;
             
             /**
-             Assignment
-             @param other reference to the _iterator to copy.
+             Conversion from a mutable _iterator to a const one
+             @param other reference to the _iterator to convert.
              */
-            _iterator& operator=(const _iterator &other) {
-                base = other.base;
-                data = other.data;
-                return *this;
-            }
+            template <bool c = is_const, typename = typename std::enable_if<c>::type>
+            _iterator(const _iterator<false> &other): data(other.data) {}
             
             /**
              Dereference pointer
@@ -77,8 +135,8 @@ namespace set {
              Return element at index
              @returns reference to the value if the element at index
              */
-            reference operator[](int index) {
-                return *base[index];
+            reference operator[](difference_type index) const {
+                return data[index];
             }
             
             /**
@@ -86,7 +144,7 @@ namespace set {
              @returns _iterator not incremented;
              */
             _iterator operator++(int) {
-                return _iterator(base, data++);
+                return _iterator(data++);
             }
             
             /**
@@ -103,7 +161,7 @@ namespace set {
              @returns _iterator not decremented;
              */
             _iterator operator--(int) {
-                return _iterator(base, data--);
+                return _iterator(data--);
             }
             
             /**
@@ -120,8 +178,18 @@ namespace set {
              @param offset how much to advance
              @returns _iterator not advanced by offset;
              */
-            _iterator operator+(int offset) {
-                return _iterator(base, data+offset);
+            _iterator operator+(difference_type offset) const {
+                return _iterator(data+offset);
+            }
+            
+            /**
+             Advance operator with the offset first;
+             @param offset how much to advance
+             @param it the _iterator to advance
+             @returns _iterator advanced by offset;
+             */
+            friend _iterator operator+(difference_type offset, const _iterator &it) {
+                return it + offset;
             }
             
             /**
@@ -129,8 +197,8 @@ namespace set {
              @param offset how much to recede
              @returns _iterator not receded by offset;
              */
-            _iterator operator-(int offset) {
-                return _iterator(base, data-offset);
+            _iterator operator-(difference_type offset) const {
+                return _iterator(data-offset);
             }
             
             /**
@@ -138,7 +206,7 @@ namespace set {
              @param offset how much to advance
              @returns _iterator advanced by offset;
              */
-            _iterator& operator+=(int offset) {
+            _iterator& operator+=(difference_type offset) {
                 data += offset;
                 return *this;
             }
@@ -148,7 +216,7 @@ namespace set {
              @param offset how much to recede
              @returns _iterator receded by offset;
              */
-            _iterator& operator-=(int offset) {
+            _iterator& operator-=(difference_type offset) {
                 data -= offset;
                 return *this;
             }
@@ -158,17 +226,18 @@ namespace set {
              @param _iterator reference to the other _iterator
              @returns how many elements between this and other _iterator
              */
-            difference_type operator-(const _iterator &other) {
-                difference_type diff = data - other.data;
-                return diff;
+            template <bool c>
+            difference_type operator-(const _iterator<c> &other) const {
+                return data - other.data;
             }
             
             /**
              Equality operator, check if the two iterators point to the same element
              @param other reference to the other _iterator
              */
-            bool operator==(const _iterator<> &other) const {
-                return data == other.data && base == other.base;
+            template <bool c>
+            bool operator==(const _iterator<c> &other) const {
+                return data == other.data;
             }
             
             /**
@@ -176,8 +245,9 @@ namespace set {
              don't point to the same element
              @param other reference to the other _iterator
              */
-            bool operator!=(const _iterator<> &other) const {
-                return data != other.data || base != other.base;
+            template <bool c>
+            bool operator!=(const _iterator<c> &other) const {
+                return data != other.data;
             }
             
             /**
@@ -185,8 +255,9 @@ namespace set {
              that is > the index of the element pointed by the other _iterator
              @param other reference to the other _iterator
              */
-            bool operator>(const _iterator<> &other) const {
-                return data > other.data && base == other.base;
+            template <bool c>
+            bool operator>(const _iterator<c> &other) const {
+                return data > other.data;
             }
             
             /**
@@ -194,8 +265,9 @@ namespace set {
              that is >= the index of the element pointed by the other _iterator
              @param other reference to the other _iterator
              */
-            bool operator>=(const _iterator<> &other) const {
-                return data >= other.data && base == other.base;
+            template <bool c>
+            bool operator>=(const _iterator<c> &other) const {
+                return data >= other.data;
             }
             
             /**
@@ -203,8 +275,9 @@ namespace set {
              that is < the index of the element pointed by the other _iterator
              @param other reference to the other _iterator
              */
-            bool operator<(const _iterator<> &other) const {
-                return data < other.data && base == other.base;
+            template <bool c>
+            bool operator<(const _iterator<c> &other) const {
+                return data < other.data;
             }
             
             /**
@@ -212,104 +285,76 @@ namespace set {
              that is <= the index of the element pointed by the other _iterator
              @param other reference to the other _iterator
              */
-            bool operator<=(const _iterator<> &other) const {
-                return data <= other.data && base == other.base;
-            }
-            
-            /**
-             Equality operator, check if the two iterators point to the same element.
-             @param other reference to the other iterator
-             */
-            bool operator==(const _iterator<false> &other) const {
-                return data == other.data && base == other.base;
-            }
-            
-            /**
-             Inequality operator, check if the two iterators
-             don't point to the same element.
-             @param other reference to the other iterator
-             */
-            bool operator!=(const _iterator<false> &other) const {
-                return data != other.data || base != other.base;
-            }
-            
-            /**
-             > operator, check a _iterator point to an element with an index in the collection
-             that is > the index of the element pointed by the other _iterator
-             @param other reference to the other iterator
-             */
-            bool operator>(const _iterator<false> &other) const {
-                return data > other.data && base == other.base;
-            }
-            
-            /**
-             >= operator, check a _iterator point to an element with an index in the collection
-             that is >= the index of the element pointed by the other iterator
-             @param other reference to the other iterator
-             */
-            bool operator>=(const _iterator<false> &other) const {
-                return data >= other.data && base == other.base;
-            }
-            
-            /**
-             < operator, check a _iterator point to an element with an index in the collection
-             that is < the index of the element pointed by the other iterator
-             @param other reference to the other iterator
-             */
-            bool operator<(const _iterator<false> &other) const {
-                return data < other.data && base == other.base;
-            }
-            
-            /**
-             <= operator, check a _iterator point to an element with an index in the collection
-             that is <= the index of the element pointed by the other iterator
-             @param other reference to the other iterator
-             */
-            bool operator<=(const _iterator<false> &other) const {
-                return data <= other.data && base == other.base;
+            template <bool c>
+            bool operator<=(const _iterator<c> &other) const {
+                return data <= other.data;
             }
             
         private:
-            T* base;
-            T* data;
+            T* data = nullptr;
             
             friend class Set;
+            template <bool> friend class _iterator;
             
-            _iterator(T* base_, T* data_): base(base_), data(data_) {}
-            _iterator(T* data_): base(data_), data(data_) {}
+            _iterator(T* data_): data(data_) {}
             
         };
         
         using const_iterator = _iterator<true>;
         using iterator       = _iterator<false>;
         
+        template <typename U, typename R>
+        using if_transparent = typename std::enable_if<is_transparent<Hash, KeyEqual>::value &&
+                                                       !std::is_same<U, T>::value, R>::type;
+        
     public:
         /**
-         Constructor
+         Constructor, the elements are kept inline without any allocation
+         until the Set grows past N elements.
          */
         Set() =default;
         
         /**
          Copy constructor, performs a deep copy of all the elements in the other Set
+         without checking them again, the filter is copied if it can be and it's already
+         built, otherwise it's built later by the first method that modifies the Set.
+         See PersistentSet for snapshots that don't copy the elements.
          @param Set& reference to the set to copy
          @returns class instance
+         @exception bad_alloc if the allocation isn't successfull
          */
-        Set(const Set& set_) {
-            size = set_.size;
-            alloc(size);
+        Set(const Set& set_): last(set_.last), capacity(set_.capacity) {
+            if (!set_.is_small()) {
+                heap = Buffer<T>(capacity);
+                elements = heap.get();
+            }
             
-            for (const auto e: set_)
-                insert(e);
+            std::copy(set_.elements, set_.elements+last+1, elements);
+            
+            if constexpr (std::is_copy_constructible<F>::value)
+                if (set_.filter) filter = std::unique_ptr<F>(new F(*set_.filter));
         }
         
         /**
-         Move constructor
+         Move constructor, steals the heap buffer and the filter of the other Set,
+         or moves the inline elements if the other Set is still small.
          */
         Set(Set&& set_) {
-            size = set_.size;
-            last = set_.last;
+            steal(set_);
+        }
+        
+        /**
+         Move assignment, see the move constructor
+         @param set_ the set to move
+         @returns reference to this Set
+         */
+        Set& operator=(Set&& set_) {
+            if (this != &set_) {
+                clear();
+                steal(set_);
+            }
             
-            data = std::move(set_.data);
+            return *this;
         }
  
         /**
@@ -321,8 +366,7 @@ namespace set {
          */
         template <typename Iterator>
         Set(Iterator begin, Iterator end) {
-            size = end - begin;
-            alloc(size);
+            reserve(end - begin);
             
             for (; begin != end; begin++)
                 try {
@@ -332,6 +376,39 @@ namespace set {
                 }
         }
         
+        /**
+         Parallel constructor from random access iterators, the result is the same
+         of the sequential one: the first occurrence of each element is kept, in order.
+         Each thread hashes a chunk of the elements and splits them in one partition
+         per thread by hash, then each thread dedups a partition visiting the elements
+         by index, so the lowest index of each element wins, finally each thread copies
+         the elements kept of its chunk in place and the filter is built in bulk.
+         @param begin first element of the iterator
+         @param end last element of the iterator
+         @param threads the number of threads to use, 0 to use all the hardware threads
+         @returns class instance
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        Set(parallel_t, Iterator begin, Iterator end, unsigned threads = 0) {
+            ingest(begin, end, threads);
+        }
+        
+        /**
+         Parallel constructor from the elements of a range marked to keep, that must be
+         distinct, like the elements of another Set: each thread copies the elements kept
+         of a chunk in place, without checking them, then the filter is built in bulk.
+         @param begin first element of the range
+         @param keep the elements to keep, one for each element of the range
+         @param threads the number of threads to use, 0 to use all the hardware threads
+         @returns class instance
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        Set(parallel_t, Iterator begin, const std::vector<uint8_t>& keep, unsigned threads = 0) {
+            gather(begin, keep.size(), keep, threads);
+        }
+        
         /**
          Subscribe operator to access element by index in costant time
          @param p the index of the element to retrieve
@@ -339,33 +416,81 @@ namespace set {
          @exception assert exception if p is outside the valide range
          */
         const T& operator[](int p) const {
-            return data[p];
+            return elements[p];
         }
         
         /**
-         Perform an insertion of an element into the Set, it checks first the Checker,
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        size_t size() const {
+            return last + 1;
+        }
+        
+        /**
+         Pointer to the elements, stored contiguously in insertion order, valid
+         until the next insertion or removal.
+         @returns pointer to the first element
+         */
+        const T* data() const {
+            return elements;
+        }
+        
+        /**
+         View of the elements, to hand them to algorithms working on contiguous memory,
+         valid until the next insertion or removal.
+         @returns the span of the elements
+         */
+        std::span<const T> view() const {
+            return std::span<const T>(elements, size());
+        }
+        
+        /**
+         Presize the Set for n elements, estimated for example with a HyperLogLog sketch
+         of the input: the buffer is allocated once and the filter is built now with room
+         for n elements, so that neither of them has to grow during the ingest.
+         @param n the number of elements expected
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void reserve_for_estimated(size_t n) {
+            reserve(n);
+            if (is_small()) return;
+            
+            filter = std::unique_ptr<F>(new F());
+            filters::reserve(*filter, n);
+            build(*filter, begin(), end());
+        }
+        
+        /**
+         Perform an insertion of an element into the Set. While the Set is small
+         the inline elements are scanned linearly, otherwise it checks first the Checker,
          if the query is negative, procedes with the insertion, if positive
          it checks for the existence of the element (could be a false positive) and
          eventually performs the insertion.
          @param t the element
          @exception already_in() if the elements is already present in the Set.
          */
-        void insert(const T t) {
-            auto query = filter.query(t);
-            if (query == Query::MAYBE) {
+        void insert(const T& t) {
+            push(t);
+        }
                 
-                for (int i=0; i <= last; i++)
-                    if (data[i] == t)
-                        throw exceptions::already_in();
+        /**
+         Insert an element moving it into the Set, see insert.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        void insert(T&& t) {
+            push(std::move(t));
+        }
                 
-            } else if (query == Query::FOUND)
-                throw exceptions::already_in();
-            
-            filter.add(t);
-            if (++last == size)
-                grow();
-            
-            data[last] = t;
+        /**
+         Construct an element in place from args and move it into the Set, see insert.
+         @param args the arguments to forward to the constructor of T
+         @exception already_in() if the elements is already present in the Set.
+         */
+        template <typename... Args>
+        void emplace(Args&&... args) {
+            push(T(std::forward<Args>(args)...));
         }
         
         /**
@@ -376,25 +501,164 @@ namespace set {
          @param t the element
          @exception not_found() if the element is not found in the Set.
          */
-        void remove(const T t) {
-            auto query = filter.query(t);
-            if (query == Query::NOT_FOUND)
-                throw exceptions::not_found();
+        void remove(const T& t) {
+            erase(t);
+        }
+        
+        /**
+         Remove an element using a key of a different type, available only
+         if Hash and KeyEqual are transparent.
+         @param t the key comparable with the element
+         @exception not_found() if the element is not found in the Set.
+         */
+        template <typename U>
+        if_transparent<U, void> remove(const U& t) {
+            erase(t);
+        }
+        
+        /**
+         Check if an element is in the Set, the filter is queried first and the
+         elements are scanned only if it returns MAYBE.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        bool contains(const T& t) const {
+            return lookup(t);
+        }
+        
+        /**
+         Check if an element is in the Set using a key of a different type without
+         converting it, available only if Hash and KeyEqual are transparent.
+         @param t the key comparable with the element
+         @returns true if the element is in the Set
+         */
+        template <typename U>
+        if_transparent<U, bool> contains(const U& t) const {
+            return lookup(t);
+        }
+        
+        /**
+         Check n elements at once. The filter is queried BATCH elements at time, so
+         that the memory accesses of the elements in the same batch overlap, and the
+         elements are scanned only for the MAYBE results.
+         @param keys pointer to the first element
+         @param n number of elements
+         @param mask bitmask of (n+63)/64 words, the i-th bit is set if the i-th element is found
+         @returns the number of elements found
+         */
+        template <typename U>
+        typename std::enable_if<std::is_same<U, T>::value || is_transparent<Hash, KeyEqual>::value, size_t>::type
+        contains_many(const U* keys, size_t n, uint64_t* mask) const {
+            std::fill(mask, mask + (n+63)/64, 0);
+            
+            size_t found = 0;
+            Query query[BATCH];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                
+                if (filter) filters::query_many(*filter, keys+b, len, query);
+                else std::fill(query, query+len, Query::MAYBE);
+                
+                for (size_t i=0; i < len; i++)
+                    if (query[i] == Query::FOUND ||
+                        (query[i] == Query::MAYBE && find_linear(elements, last+1, keys[b+i], equal) != -1)) {
+                        mask[(b+i) / 64] |= uint64_t(1) << ((b+i) % 64);
+                        found++;
+                    }
+            }
+            
+            return found;
+        }
+        
+        /**
+         Insert n elements at once, skipping the ones already in the Set or repeated
+         in keys. The buffer is grown once for all the elements, at least by the factor
+         of the growth policy so that repeated calls don't copy it every time, then
+         for every BATCH elements the filter is queried together, the new elements are
+         appended and added to the filter together.
+         @param keys pointer to the first element
+         @param n number of elements
+         @param mask optional bitmask of (n+63)/64 words, the i-th bit is set if the i-th element is inserted
+         @returns the number of elements inserted
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        size_t insert_many(const T* keys, size_t n, uint64_t* mask = nullptr) {
+            if (mask) std::fill(mask, mask + (n+63)/64, 0);
             
-            for (int i=0; i <= last; i++) {
-                if (data[i] == t) {
+            if (size() + n > capacity)
+                reserve(std::max(size() + n, Growth::grow(capacity)));
+            
+            size_t inserted = 0;
+            Query query[BATCH];
+            
+            for (size_t b=0; b < n; b += BATCH) {
+                auto len = std::min(BATCH, n-b);
+                int first = last+1;
+                
+                F* f = is_small() ? nullptr : &checker();
+                
+                if (f) filters::query_many(*f, keys+b, len, query);
+                else std::fill(query, query+len, Query::MAYBE);
+                
+                for (size_t i=0; i < len; i++) {
+                    if (query[i] == Query::FOUND) continue;
                     
-                    filter.remove(t);
-                    std::rotate(ibegin()+i, ibegin()+i+1, iend());
+                    // elements inserted by this batch aren't in the filter yet
+                    auto from = query[i] == Query::MAYBE ? 0 : first;
+                    if (find_linear(elements+from, last+1-from, keys[b+i], equal) != -1) continue;
                     
-                    data[last].~T();
+                    elements[++last] = keys[b+i];
                     
-                    if (--last < size/2) shrink();
-                    return;
+                    if (mask) mask[(b+i) / 64] |= uint64_t(1) << ((b+i) % 64);
+                    inserted++;
                 }
+                
+                if (f) filters::add_many(*f, elements+first, last+1-first);
             }
             
-            throw exceptions::not_found();
+            return inserted;
+        }
+        
+        /**
+         Merge the elements of another Set into this one, appending the ones not
+         present in the same order. The filter of this Set is queried for all the
+         elements first, the ones it rules out are appended without any scan, since
+         the elements of the other Set are already distinct, then the filter of the
+         other Set is merged into this one, or the new elements are added one by one
+         if the filters can't be merged.
+         @param other the Set to merge
+         @returns the number of elements added
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        size_t merge(const Set& other) {
+            if (&other == this) return 0;
+            
+            reserve(size() + other.size());
+            if (is_small()) return insert_many(other.elements, other.size());
+            
+            auto& f = checker();
+            int first = last+1;
+            Query query[BATCH];
+            
+            for (size_t b=0; b < other.size(); b += BATCH) {
+                auto len = std::min(BATCH, other.size()-b);
+                filters::query_many(f, other.elements+b, len, query);
+                
+                for (size_t i=0; i < len; i++) {
+                    if (query[i] == Query::FOUND) continue;
+                    
+                    const auto& t = other.elements[b+i];
+                    if (query[i] == Query::MAYBE && find_linear(elements, first, t, equal) != -1) continue;
+                    
+                    elements[++last] = t;
+                }
+            }
+            
+            if (!other.filter || !filters::merge(f, *other.filter))
+                filters::add_many(f, elements+first, last+1-first);
+            
+            return last+1-first;
         }
         
         /**
@@ -402,7 +666,7 @@ namespace set {
          @returns the const_iterator
          */
         const_iterator begin() const {
-            return const_iterator(data.get());
+            return const_iterator(elements);
         }
         
         /**
@@ -410,16 +674,184 @@ namespace set {
          @returns the const_iterator
          */
         const_iterator end() const {
-            return const_iterator(data.get(), data.get()+last+1);
+            return const_iterator(elements+last+1);
         }
         
     private:
+        /**
+         Search an element, querying the filter first if it's already built.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        template <typename U>
+        bool lookup(const U& t) const {
+            if (filter) {
+                auto query = filter->query(t);
+                if (query != Query::MAYBE) return query == Query::FOUND;
+            }
+            
+            return find_linear(elements, last+1, t, equal) != -1;
+        }
+        
+        /**
+         Insert the element, see insert.
+         @param t the element
+         @exception already_in() if the elements is already present in the Set.
+         */
+        template <typename U>
+        void push(U&& t) {
+            if (is_small()) {
+                if (find_linear(elements, last+1, t, equal) != -1)
+                    throw exceptions::already_in();
+                
+                if (last+1 < N) {
+                    elements[++last] = std::forward<U>(t);
+                    return;
+                }
+                
+                spill(Growth::grow(N));
+            } else {
+                auto query = checker().query(t);
+                if (query == Query::MAYBE) {
+                    
+                    if (find_linear(elements, last+1, t, equal) != -1)
+                        throw exceptions::already_in();
+                    
+                } else if (query == Query::FOUND)
+                    throw exceptions::already_in();
+            }
+            
+            checker().add(t);
+            if (last+1 == capacity)
+                grow();
+            
+            elements[++last] = std::forward<U>(t);
+        }
+        
+        /**
+         Build the Set from a range in parallel, see the parallel constructor.
+         @param begin first element of the range
+         @param end last element of the range
+         @param threads the number of threads to use, 0 to use all the hardware threads
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        void ingest(Iterator begin, Iterator end, unsigned threads) {
+            size_t n = end - begin;
+            
+            if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+            threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, n)));
+            
+            Hash hashfn;
+            std::vector<size_t> hashes(n);
+            std::vector<std::vector<std::vector<size_t>>> parts(threads, std::vector<std::vector<size_t>>(threads));
+            
+            parallel_for(n, threads, [&](size_t b, size_t e, unsigned t) {
+                for (auto i=b; i < e; i++) {
+                    hashes[i] = static_hasher<uint64_t>::mix(hashfn(begin[i]));
+                    parts[t][hashes[i] % threads].push_back(i);
+                }
+            });
+            
+            std::vector<uint8_t> keep(n);
+            
+            parallel_for(threads, threads, [&](size_t p, size_t, unsigned) {
+                size_t count = 0;
+                for (auto& part: parts)
+                    count += part[p].size();
+                
+                size_t mask = 1;
+                while (mask < 2*count) mask <<= 1;
+                mask--;
+                
+                // open addressing table of index+1, the chunks are visited in order
+                std::vector<size_t> slots(mask+1);
+                
+                for (auto& part: parts)
+                    for (auto i: part[p]) {
+                        auto s = (hashes[i] / threads) & mask;
+                        
+                        while (slots[s] && !(hashes[slots[s]-1] == hashes[i] && equal(begin[slots[s]-1], begin[i])))
+                            s = (s+1) & mask;
+                        
+                        if (!slots[s]) {
+                            slots[s] = i+1;
+                            keep[i] = 1;
+                        }
+                    }
+            });
+            
+            gather(begin, n, keep, threads);
+        }
+        
+        /**
+         Copy the elements of a range that are marked to keep in the empty Set, each
+         thread copies the elements of a chunk at the offset given by the elements
+         kept in the chunks before it, then the filter is built in bulk.
+         The elements kept must be distinct.
+         @param begin first element of the range
+         @param n the number of elements of the range
+         @param keep the elements to keep
+         @param threads the number of threads to use
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        template <typename Iterator>
+        void gather(Iterator begin, size_t n, const std::vector<uint8_t>& keep, unsigned threads) {
+            if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+            
+            std::vector<size_t> offset(threads+1);
+            
+            parallel_for(n, threads, [&](size_t b, size_t e, unsigned t) {
+                offset[t+1] = std::count(keep.begin()+b, keep.begin()+e, 1);
+            });
+            
+            std::partial_sum(offset.begin(), offset.end(), offset.begin());
+            reserve(offset[threads]);
+            
+            parallel_for(n, threads, [&](size_t b, size_t e, unsigned t) {
+                auto o = offset[t];
+                
+                for (auto i=b; i < e; i++)
+                    if (keep[i]) elements[o++] = begin[i];
+            });
+            
+            last = static_cast<int>(offset[threads]) - 1;
+            
+            if (!is_small()) {
+                filter = std::unique_ptr<F>(new F());
+                build(*filter, elements, elements+last+1);
+            }
+        }
+        
+        /**
+         Remove the element, see remove.
+         @param t the element
+         @exception not_found() if the element is not found in the Set.
+         */
+        template <typename U>
+        void erase(const U& t) {
+            if (!is_small() && checker().query(t) == Query::NOT_FOUND)
+                throw exceptions::not_found();
+            
+            auto i = find_linear(elements, last+1, t, equal);
+            if (i == -1)
+                throw exceptions::not_found();
+            
+            if (!is_small())
+                filter->remove(t);
+            
+            std::rotate(ibegin()+i, ibegin()+i+1, iend());
+            elements[last--] = T();
+            
+            if (!is_small() && Growth::shrinks(last+1, capacity)) shrink();
+        }
+        
         /**
          Return the iterator, pointing at the first element
          @returns the iterator
          */
         iterator ibegin() {
-            return iterator(data.get());
+            return iterator(elements);
         }
         
         /**
@@ -427,38 +859,139 @@ namespace set {
          @returns the iterator
          */
         iterator iend() {
-            return iterator(data.get(), data.get()+last+1);
+            return iterator(elements+last+1);
         }
         
         /**
-         Grows the size of the buffer exponentially
+         Check if the elements are still stored inline.
+         @returns true if the Set is in small mode
+         */
+        bool is_small() const {
+            return elements == local;
+        }
+        
+        /**
+         Take the elements and the filter of the other Set, leaving it empty.
+         @param set_ the set to steal from
+         */
+        void steal(Set& set_) {
+            last = set_.last;
+            capacity = set_.capacity;
+            filter = std::move(set_.filter);
+            
+            if (set_.is_small()) {
+                std::move(set_.elements, set_.elements+last+1, local);
+                elements = local;
+            } else {
+                heap = std::move(set_.heap);
+                elements = heap.get();
+            }
+            
+            set_.clear();
+        }
+        
+        /**
+         Remove all the elements and release the heap buffer and the filter.
+         */
+        void clear() {
+            std::fill(local, local+N, T());
+            
+            last = -1;
+            capacity = N;
+            elements = local;
+            heap.reset();
+            filter.reset();
+        }
+        
+        /**
+         Make room for at least s elements, moving to the heap if they don't fit inline.
+         @param s the number of elements
          @exception bad_alloc if the allocation isn't successfull
          */
-        void grow() {
-            if (size) size *= 2;
-            else size = 1;
+        void reserve(size_t s) {
+            if (s <= capacity) return;
+            
+            if (is_small()) spill(s);
+            else {
+                capacity = s;
+                alloc(capacity);
+            }
+        }
+        
+        /**
+         Move the inline elements to a heap buffer of size s, the filter is built
+         later by checker.
+         @param s the size of the heap buffer
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void spill(size_t s) {
+            capacity = s;
+            alloc(capacity);
+        }
+        
+        /**
+         Return the filter, building it from the elements of the Set the first time it's
+         needed and rebuilding it when it's stale and has to change structure.
+         Only the methods that modify the Set call it.
+         @returns reference to the filter
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        F& checker() {
+            if (!filter) {
+                filter = std::unique_ptr<F>(new F());
+                build(*filter, begin(), end());
+            } else if (stale(*filter))
+                build(*filter, begin(), end());
             
-            alloc(size);
+            return *filter;
         }
         
         /**
-         Shrink the size of the buffer exponentially
+         Grows the size of the buffer exponentially, by the factor of the growth policy
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void grow() {
+            capacity = Growth::grow(capacity);
+            alloc(capacity);
+        }
+        
+        /**
+         Shrink the size of the buffer exponentially, by the factor of the growth policy,
+         once there are less than N/2 elements they are moved back inline and the filter is dropped.
          @exception bad_alloc if the allocation isn't successfull
          */
         void shrink() {
-            size /= 1.5;
-            alloc(size);
+            if (last+1 < N/2) {
+                std::move(elements, elements+last+1, local);
+                
+                elements = local;
+                capacity = N;
+                heap.reset();
+                filter.reset();
+                
+                return;
+            }
+            
+            capacity = Growth::shrink(last+1, capacity);
+            alloc(capacity);
         }
         
         /**
-         Realloc a chunk of memory based on the size passed.
+         Realloc a chunk of memory based on the size passed, a buffer mapped
+         with huge pages is remapped without copying the elements.
          @param s
          @exception bad_alloc if the allocation isn't successfull
          */
         void alloc(size_t s) {
-            auto mem = std::unique_ptr<T[]>(new T[s]);
-            std::copy(begin(), end(), mem.get());
-            data.swap(mem);
+            if (is_small()) {
+                Buffer<T> mem(s);
+                std::move(elements, elements+last+1, mem.get());
+                
+                heap = std::move(mem);
+            } else
+                heap.resize(s, last+1);
+            
+            elements = heap.get();
         }
         
         /**
@@ -468,17 +1001,23 @@ namespace set {
          @return output stream
          */
         friend std::ostream& operator<<(std::ostream &os, const Set &set) {
-            for (const auto e: set) {
+            for (const auto& e: set) {
                 os << e << " ";
             }
             
             return os;
         }
         
-        F filter;
         int last = -1;
-        size_t size = 1;
-        std::unique_ptr<T[]> data = std::unique_ptr<T[]>(new T[size]);
+        size_t capacity = N;
+        
+        T local[N];
+        T* elements = local;
+        
+        Buffer<T> heap;
+        mutable std::unique_ptr<F> filter;
+        
+        KeyEqual equal;
     };
     
     /**
@@ -488,11 +1027,11 @@ namespace set {
      @param p the function or lambda to use to filter the elements
      @returns the new Set
      */
-    template <typename T, typename F, typename P>
-    Set<T,F> filter_out(const Set<T,F>& s, P p) {
-        Set<T,F> n_s;
+    template <typename T, typename F, size_t N, typename H, typename E, typename G, typename P>
+    Set<T,F,N,H,E,G> filter_out(const Set<T,F,N,H,E,G>& s, P p) {
+        Set<T,F,N,H,E,G> n_s;
         
-        for (const auto e: s)
+        for (const auto& e: s)
             if (!p(e))
                 n_s.insert(e);
         
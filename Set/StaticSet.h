@@ -0,0 +1,227 @@
+//
+//  StaticSet.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_StaticSet_h
+#define Set_StaticSet_h
+
+#include <array>
+
+#include "Exceptions.h"
+#include "Utils.h"
+
+namespace set {
+    
+    using namespace utils;
+    
+    /**
+     Class that implement an immutable Set-like structure built at compile time
+     from a list of elements, with random access in O(1), ordered by insertion
+     and lookup in O(1) through a perfect hash function.
+     The perfect hash uses the hash and displace scheme: the elements are split
+     in buckets by a first hash, then for every bucket, starting from the largest,
+     it searches the seed of the hash function that puts all its elements in free slots.
+     A lookup costs two hashes and one comparison.
+     
+     @param T the type of the values inside the Set, must be a literal type
+     @param N the number of elements
+     @param Hash the hash function, must be usable in constant expressions
+     @param KeyEqual the equality used to compare the elements
+     */
+    template <typename T,
+              size_t N,
+              typename Hash = static_hasher<T>,
+              typename KeyEqual = std::equal_to<>>
+    class StaticSet {
+        
+        static constexpr size_t SLOTS = N ? N : 1;
+        static constexpr size_t MAX_SEED = 1 << 20;
+    
+    public:
+        using const_iterator = const T*;
+        
+        /**
+         Constructor from an array of elements, builds the perfect hash.
+         @param list the elements
+         @exception already_in() if an element appears twice, that in a constant
+         expression stops the compilation.
+         @exception runtime_error if the hash function can't be made perfect
+         */
+        constexpr StaticSet(const T (&list)[N]) {
+            for (size_t i=0; i < N; i++)
+                elements[i] = list[i];
+            
+            build();
+        }
+        
+        /**
+         Subscribe operator to access element by index in costant time
+         @param p the index of the element to retrieve
+         @returns const reference to the element
+         */
+        constexpr const T& operator[](size_t p) const {
+            return elements[p];
+        }
+        
+        /**
+         Number of elements in the Set
+         @returns the number of elements
+         */
+        constexpr size_t size() const {
+            return N;
+        }
+        
+        /**
+         Check if an element is in the Set.
+         @param t the element
+         @returns true if the element is in the Set
+         */
+        template <typename U>
+        constexpr bool contains(const U& t) const {
+            return index_of(t) != -1;
+        }
+        
+        /**
+         Return the index of an element.
+         @param t the element
+         @returns the index of the element, -1 if not found
+         */
+        template <typename U>
+        constexpr int index_of(const U& t) const {
+            if (!N) return -1;
+            
+            auto i = slots[slot(t, seeds[slot(t, 0)])];
+            
+            return equal(elements[i], t) ? int(i) : -1;
+        }
+        
+        /**
+         Return the const_iterator, pointing at the first element
+         @returns the const_iterator
+         */
+        constexpr const_iterator begin() const {
+            return elements.data();
+        }
+        
+        /**
+         Return the const_iterator, pointing at the element after the last
+         @returns the const_iterator
+         */
+        constexpr const_iterator end() const {
+            return elements.data() + N;
+        }
+    
+    private:
+        /**
+         Hash the element with the seed and reduce it in the range 0 <= hash < N.
+         @param t the element
+         @param seed the seed of the hash function
+         @returns the slot
+         */
+        template <typename U>
+        constexpr size_t slot(const U& t, size_t seed) const {
+            return hashfn(t, seed) % SLOTS;
+        }
+        
+        /**
+         Build the perfect hash, sorting the elements by bucket and placing
+         the buckets from the largest to the smallest.
+         */
+        constexpr void build() {
+            std::array<size_t, SLOTS+1> start{};
+            std::array<size_t, SLOTS> order{};
+            std::array<bool, SLOTS> used{};
+            
+            for (size_t i=0; i < N; i++)
+                start[slot(elements[i], 0) + 1]++;
+            
+            for (size_t b=0; b < SLOTS; b++)
+                start[b+1] += start[b];
+            
+            auto fill = start;
+            for (size_t i=0; i < N; i++)
+                order[fill[slot(elements[i], 0)]++] = i;
+            
+            size_t largest = 0;
+            for (size_t b=0; b < SLOTS; b++)
+                largest = std::max(largest, start[b+1] - start[b]);
+            
+            for (auto len = largest; len > 0; len--)
+                for (size_t b=0; b < SLOTS; b++)
+                    if (start[b+1] - start[b] == len)
+                        place(b, order.data() + start[b], len, used);
+        }
+        
+        /**
+         Search the seed that puts all the elements of the bucket in free slots.
+         @param b the bucket
+         @param bucket the indexes of the elements in the bucket
+         @param len the number of elements in the bucket
+         @param used the slots already taken
+         */
+        constexpr void place(size_t b, const size_t* bucket, size_t len, std::array<bool, SLOTS>& used) {
+            std::array<size_t, SLOTS> taken{};
+            
+            for (size_t seed=1; seed < MAX_SEED; seed++) {
+                auto ok = true;
+                
+                for (size_t j=0; j < len && ok; j++) {
+                    taken[j] = slot(elements[bucket[j]], seed);
+                    ok = !used[taken[j]];
+                    
+                    for (size_t k=0; k < j && ok; k++)
+                        if (taken[k] == taken[j]) {
+                            if (equal(elements[bucket[k]], elements[bucket[j]]))
+                                throw exceptions::already_in();
+                            
+                            ok = false;
+                        }
+                }
+                
+                if (!ok) continue;
+                
+                for (size_t j=0; j < len; j++) {
+                    used[taken[j]] = true;
+                    slots[taken[j]] = bucket[j];
+                }
+                
+                seeds[b] = seed;
+                return;
+            }
+            
+            throw std::runtime_error("No perfect hash");
+        }
+        
+        std::array<T, SLOTS> elements{};
+        std::array<size_t, SLOTS> slots{};
+        std::array<size_t, SLOTS> seeds{};
+        
+        Hash hashfn{};
+        KeyEqual equal{};
+    };
+    
+    /**
+     Deduction guide, to build a StaticSet from a braced list of elements.
+     */
+    template <typename T, size_t N>
+    StaticSet(const T (&)[N]) -> StaticSet<T, N>;
+    
+    /**
+     Create a new StaticSet from the elements passed, converted to T.
+     @param args the elements, at least one
+     @returns the StaticSet
+     */
+    template <typename T, typename... Args>
+    constexpr StaticSet<T, sizeof...(Args)> make_static_set(Args&&... args) {
+        static_assert(sizeof...(Args) > 0, "make_static_set needs at least one element");
+        
+        const T list[] = { T(std::forward<Args>(args))... };
+        
+        return StaticSet<T, sizeof...(Args)>(list);
+    }
+}
+
+#endif
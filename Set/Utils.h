@@ -10,17 +10,89 @@
 #define Set_Utils_h
 
 #include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 namespace set { namespace utils {
 
+    /**
+     Default hash function, std::hash for every type except strings, that are
+     hashed as std::string_view so that they can be looked up without building
+     a temporary std::string.
+     */
+    template <typename T>
+    struct hasher: public std::hash<T> {};
+    
+    template <>
+    struct hasher<std::string> {
+        using is_transparent = void;
+        
+        size_t operator()(std::string_view s) const {
+            return std::hash<std::string_view>()(s);
+        }
+    };
+    
+    /**
+     Hash function usable in constant expressions, takes a seed to select one of
+     a family of hash functions. Integral types are mixed with the splitmix64
+     finalizer, strings are hashed with FNV-1a.
+     */
+    template <typename T, typename = void>
+    struct static_hasher;
+    
+    template <typename T>
+    struct static_hasher<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+        constexpr size_t operator()(T t, size_t seed=0) const {
+            return mix(uint64_t(t) + seed * 0x9e3779b97f4a7c15ull);
+        }
+        
+        static constexpr uint64_t mix(uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            
+            return x ^ (x >> 31);
+        }
+    };
+    
+    template <>
+    struct static_hasher<std::string_view> {
+        using is_transparent = void;
+        
+        constexpr size_t operator()(std::string_view s, size_t seed=0) const {
+            uint64_t h = 0xcbf29ce484222325ull ^ (seed * 0x9e3779b97f4a7c15ull);
+            
+            for (auto c: s)
+                h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+            
+            return static_hasher<uint64_t>::mix(h);
+        }
+    };
+    
+    /**
+     Check if both the hash function and the equality are transparent, that is
+     if they accept any type comparable with the key.
+     */
+    template <typename Hash, typename KeyEqual, typename = void>
+    struct is_transparent: public std::false_type {};
+    
+    template <typename Hash, typename KeyEqual>
+    struct is_transparent<Hash, KeyEqual,
+                          std::void_t<typename Hash::is_transparent,
+                                      typename KeyEqual::is_transparent>>: public std::true_type {};
+
     /**
      Combine two hashes
      @param t element to hash
+     @param hashfn the hash function
      @returns hashed value
      */
-    template <typename T>
-    inline size_t hash_combine(const T& t, size_t seed) {
-        std::hash<T> hashfn;
+    template <typename T, typename Hash = std::hash<T>>
+    inline size_t hash_combine(const T& t, size_t seed, const Hash& hashfn = Hash()) {
         seed ^= hashfn(t) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         
         return seed;
@@ -34,16 +106,122 @@ namespace set { namespace utils {
      (https://www.eecs.harvard.edu/~michaelm/postscripts/tr-02-05.pdf)
      @param t the element to hash
      @param i the i-th hash function
+     @param hashfn the hash function
      @returns int the hash
      */
-    template <typename T>
-    size_t hash(const T t, size_t size, int i=0, size_t seed=0) {
-        auto h1 = hash_combine(t, seed);
-        auto h2 = hash_combine(t, h1);
+    template <typename T, typename Hash = std::hash<T>>
+    size_t hash(const T& t, size_t size, int i=0, size_t seed=0, const Hash& hashfn = Hash()) {
+        auto h1 = hash_combine(t, seed, hashfn);
+        auto h2 = hash_combine(t, h1, hashfn);
         
         return (h1 + i*h2) % size;
     }
     
+    /**
+     Compute the two hashes used by hash, so that the i-th hash function can be
+     derived as (h1 + i*h2) % size without hashing the element again.
+     @param t the element to hash
+     @param hashfn the hash function
+     @returns the pair h1, h2
+     */
+    template <typename T, typename Hash = std::hash<T>>
+    std::pair<size_t, size_t> hash_pair(const T& t, size_t seed=0, const Hash& hashfn = Hash()) {
+        auto h1 = hash_combine(t, seed, hashfn);
+        auto h2 = hash_combine(t, h1, hashfn);
+        
+        return {h1, h2};
+    }
+    
+    /**
+     Number of elements hashed and prefetched together by the batched operations.
+     */
+    constexpr size_t BATCH = 32;
+    
+    /**
+     Hint the processor to load in cache the memory pointed by p.
+     @param p the address to prefetch
+     */
+    inline void prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(p);
+#endif
+    }
+    
+    /**
+     Linear search of t in the first n elements of data.
+     @param data pointer to the first element
+     @param n number of elements to scan
+     @param t the element to search
+     @param equal the equality
+     @returns the index of the element, -1 if not found
+     */
+    template <typename T, typename U, typename KeyEqual = std::equal_to<>>
+    typename std::enable_if<!std::is_arithmetic<T>::value, int>::type
+    find_linear(const T* data, int n, const U& t, const KeyEqual& equal = KeyEqual()) {
+        for (int i=0; i < n; i++)
+            if (equal(data[i], t)) return i;
+
+        return -1;
+    }
+
+    /**
+     Linear search specialized for arithmetic types, compares blocks of 32 elements
+     without branches collecting the result in a bitmask, so that the compiler
+     can vectorize the inner loop.
+     @param data pointer to the first element
+     @param n number of elements to scan
+     @param t the element to search
+     @param equal the equality
+     @returns the index of the element, -1 if not found
+     */
+    template <typename T, typename U, typename KeyEqual = std::equal_to<>>
+    typename std::enable_if<std::is_arithmetic<T>::value, int>::type
+    find_linear(const T* data, int n, const U& t, const KeyEqual& equal = KeyEqual()) {
+        for (int b=0; b < n; b += 32) {
+            auto len = std::min(32, n-b);
+            uint32_t mask = 0;
+
+            for (int i=0; i < len; i++)
+                mask |= uint32_t(equal(data[b+i], t)) << i;
+
+            if (mask) return b + __builtin_ctz(mask);
+        }
+
+        return -1;
+    }
+    
+    /**
+     Split the range 0 <= i < n in contiguous chunks and run f(begin, end, chunk)
+     on each of them, one thread per chunk, waiting for all the threads to finish.
+     @param n the size of the range
+     @param threads the number of threads, 0 to use the hardware concurrency
+     @param f the function to run on each chunk
+     */
+    template <typename Function>
+    void parallel_for(size_t n, unsigned threads, Function f) {
+        if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, n)));
+        
+        auto chunk = (n + threads - 1) / threads;
+        std::vector<std::thread> pool;
+        
+        for (unsigned t=1; t < threads; t++)
+            pool.emplace_back(f, std::min(n, t*chunk), std::min(n, (t+1)*chunk), t);
+        
+        f(0, std::min(n, chunk), 0u);
+        
+        for (auto& th: pool)
+            th.join();
+    }
+    
+    /**
+     Tag to select the parallel version of a constructor.
+     */
+    struct parallel_t {
+        explicit parallel_t() =default;
+    };
+    
+    constexpr parallel_t parallel{};
     
     /**
      Enumerator class to rappresent the results of a Query
@@ -0,0 +1,202 @@
+//
+//  WindowedSet.h
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#ifndef Set_WindowedSet_h
+#define Set_WindowedSet_h
+
+#include <array>
+#include <chrono>
+
+#include "Set.h"
+
+namespace set {
+    
+    /**
+     Class that implement a Set-like structure that remembers only the elements inserted
+     in a sliding window, to dedup unbounded streams with bounded memory.
+     The elements are split in G generations, each one a Set with its own filter, the
+     new elements go in the newest generation and when it's full, or its time span is
+     over, the oldest generation is dropped as a whole and becomes the newest, so the
+     expiry doesn't remove the elements one by one.
+     The queries check the live generations from the newest to the oldest.
+     
+     @param T the type of the values inside the Set
+     @param F the filter of each generation
+     @param G the number of generations
+     @param Clock the clock used by the time based window
+     @param N the number of elements kept inline by each generation
+     @param Hash the hash function, the filter should use the same
+     @param KeyEqual the equality used to compare the elements
+     */
+    template <typename T,
+              typename F = BloomFilter<T>,
+              size_t G = 4,
+              typename Clock = std::chrono::steady_clock,
+              size_t N = 16,
+              typename Hash = hasher<T>,
+              typename KeyEqual = std::equal_to<>>
+    class WindowedSet {
+        
+        static_assert(G > 1, "WindowedSet needs at least two generations");
+        
+        using Generation = Set<T, F, N, Hash, KeyEqual>;
+    
+    public:
+        using duration   = typename Clock::duration;
+        using time_point = typename Clock::time_point;
+        
+        /**
+         Constructor for a window of the last G * limit elements, a generation
+         is rotated after limit insertions, so each one is presized for limit.
+         @param limit_ the number of elements of each generation
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        WindowedSet(size_t limit_): limit(limit_), expected(limit_) {
+            started.fill(Clock::now());
+            presize();
+        }
+        
+        /**
+         Constructor for a window of the last G * span time, a generation is
+         rotated after span time and expires G * span after it started.
+         Each generation is presized for the elements expected in a span, if
+         they're given, otherwise its filter starts from its default size.
+         @param span_ the time span of each generation
+         @param expected_ the number of elements expected in each generation
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        WindowedSet(duration span_, size_t expected_ = 0): expected(expected_), span(span_) {
+            started.fill(Clock::now());
+            presize();
+        }
+        
+        /**
+         Number of elements in the live generations
+         @returns the number of elements
+         */
+        size_t size() const {
+            auto now = Clock::now();
+            size_t s = 0;
+            
+            for (size_t age=0; age < G && live(age, now); age++)
+                s += generations[index(age)].size();
+            
+            return s;
+        }
+        
+        /**
+         Insert an element into the newest generation, rotating the generations first
+         if the newest one is full or its time span is over.
+         @param t the element
+         @exception already_in() if the elements is in one of the live generations.
+         */
+        void insert(const T& t) {
+            if (!add(t))
+                throw exceptions::already_in();
+        }
+        
+        /**
+         Insert an element if it isn't in the live generations, see insert.
+         @param t the element
+         @returns true if inserted, false if already seen in the window
+         */
+        bool add(const T& t) {
+            advance();
+            
+            if (contains(t)) return false;
+            
+            generations[head].insert(t);
+            return true;
+        }
+        
+        /**
+         Check if an element is in the live generations, from the newest to the oldest.
+         @param t the element
+         @returns true if the element is in the window
+         */
+        template <typename U>
+        bool contains(const U& t) const {
+            auto now = Clock::now();
+            
+            for (size_t age=0; age < G && live(age, now); age++)
+                if (generations[index(age)].contains(t)) return true;
+            
+            return false;
+        }
+        
+        /**
+         Drop the oldest generation and start a new one, in constant time, presized
+         for the elements expected, so that its filter isn't overloaded before the
+         next rotation.
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void rotate() {
+            head = index(G-1);
+            
+            generations[head] = Generation();
+            started[head] = Clock::now();
+            
+            if (expected) generations[head].reserve_for_estimated(expected);
+        }
+    
+    private:
+        /**
+         Presize every generation for the elements expected, if they're known.
+         @exception bad_alloc if the allocation isn't successfull
+         */
+        void presize() {
+            if (!expected) return;
+            
+            for (auto& g: generations)
+                g.reserve_for_estimated(expected);
+        }
+        
+        /**
+         Return the position of the generation with the given age, 0 is the newest.
+         @param age the age of the generation
+         @returns the position in the ring
+         */
+        size_t index(size_t age) const {
+            return (head + G - age) % G;
+        }
+        
+        /**
+         Check if a generation is still inside the time window.
+         @param age the age of the generation
+         @param now the current time
+         @returns true if live
+         */
+        bool live(size_t age, time_point now) const {
+            return span == duration::zero() || now - started[index(age)] < span * G;
+        }
+        
+        /**
+         Rotate the generations that are over, by size or by time, at most
+         G times since after that all of them are new.
+         */
+        void advance() {
+            if (limit && generations[head].size() >= limit)
+                rotate();
+            
+            if (span == duration::zero()) return;
+            
+            auto now = Clock::now();
+            for (size_t i=0; i < G && now - started[head] >= span; i++)
+                rotate();
+        }
+        
+        std::array<Generation, G> generations;
+        std::array<time_point, G> started;
+        size_t head = 0;
+        
+        size_t limit = 0;
+        size_t expected = 0;
+        duration span = duration::zero();
+    };
+}
+
+#endif
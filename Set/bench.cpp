@@ -0,0 +1,229 @@
+//
+//  bench.cpp
+//  Set
+//
+//  Copyright (c) 2015 Gabriele Carrettoni. All rights reserved.
+//
+
+#include "Set.h"
+
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace set;
+
+/**
+ The elements kept inline by the Sets of the benchmark.
+ */
+static constexpr size_t INLINE = 16;
+
+/**
+ The size around which the capacities of the benchmark are picked.
+ */
+static constexpr size_t TARGET = 2000;
+
+/**
+ The policy before GrowthPolicy: doubles when full, divides by 1.5 as soon
+ as the elements are half the capacity.
+ */
+struct EagerShrink {
+    static size_t grow(size_t capacity) {
+        return capacity * 2;
+    }
+    
+    static bool shrinks(size_t size, size_t capacity) {
+        return size - 1 < capacity / 2;
+    }
+    
+    static size_t shrink(size_t size, size_t capacity) {
+        return std::max(size, size_t(capacity / 1.5));
+    }
+};
+
+/**
+ The values of the benchmark are between 0 and VALUES.
+ */
+static constexpr size_t VALUES = 1 << 16;
+
+/**
+ Exact filter on a bitmap of all the values, every operation is a single bit, so
+ the time spent reallocating the buffer isn't hidden by the filter or by the scans.
+ */
+struct BitmapFilter {
+    void add(int t) {
+        bits.set(t);
+    }
+    
+    Query query(int t) {
+        return bits.test(t) ? Query::FOUND : Query::NOT_FOUND;
+    }
+    
+    void remove(int t) {
+        bits.reset(t);
+    }
+    
+    std::bitset<VALUES> bits;
+};
+
+/**
+ The Set of the benchmark.
+ */
+template <typename Growth>
+using BenchSet = Set<int, BitmapFilter, INLINE, hasher<int>, std::equal_to<>, Growth>;
+
+/**
+ Class that wraps a Set and counts the operations and the ones that reallocated the buffer.
+ */
+template <typename Growth>
+struct Probe {
+    BenchSet<Growth> s;
+    size_t ops = 0;
+    size_t reallocs = 0;
+    
+    void insert(int t) {
+        auto data = s.data();
+        s.insert(t);
+        count(data);
+    }
+    
+    void remove(int t) {
+        auto data = s.data();
+        s.remove(t);
+        count(data);
+    }
+    
+    void count(const int* data) {
+        ops++;
+        if (s.data() != data) reallocs++;
+    }
+};
+
+/**
+ Capacity of the heap buffer once the Set has grown to at least n elements,
+ following the growth policy from the inline elements.
+ @param n the number of elements
+ @returns the capacity
+ */
+template <typename Growth>
+size_t capacity_for(size_t n) {
+    auto capacity = Growth::grow(INLINE);
+    while (capacity < n)
+        capacity = Growth::grow(capacity);
+    
+    return capacity;
+}
+
+/**
+ Window sizes at the boundaries of the policy: the capacity around TARGET and
+ half of it, each one minus and plus one, and the largest size that shrinks a
+ full buffer of that capacity, with its neighbours, if the policy shrinks.
+ @returns the capacity and the window sizes
+ */
+template <typename Growth>
+std::pair<size_t, std::vector<size_t>> boundaries() {
+    auto capacity = capacity_for<Growth>(TARGET);
+    std::vector<size_t> windows;
+    
+    for (auto b: {capacity, capacity / 2})
+        windows.insert(windows.end(), {b - 1, b, b + 1});
+    
+    auto shrink = capacity;
+    while (shrink > 0 && !Growth::shrinks(shrink, capacity))
+        shrink--;
+    
+    if (shrink > 1) windows.insert(windows.end(), {shrink - 1, shrink, shrink + 1});
+    
+    std::sort(windows.begin(), windows.end());
+    windows.erase(std::unique(windows.begin(), windows.end()), windows.end());
+    
+    return {capacity, windows};
+}
+
+/**
+ Run a workload on every window size at the boundaries of the policy, starting
+ each time from a full buffer of the capacity that is then filled or emptied to
+ the window, and print the time and the reallocations per operation, in total
+ and for the worst window.
+ @param policy the name of the policy
+ @param workload the name of the workload
+ @param rounds the number of rounds for each window size
+ @param step the function that runs one round on the Probe
+ */
+template <typename Growth, typename Step>
+void run(const char* policy, const char* workload, int rounds, Step step) {
+    auto [capacity, windows] = boundaries<Growth>();
+    
+    size_t ops = 0, reallocs = 0, worst = 0;
+    double worst_rate = 0, ns = 0;
+    
+    for (auto w: windows) {
+        Probe<Growth> p;
+        
+        for (size_t i=0; i < std::max(w, capacity); i++)
+            p.s.insert(int(i));
+        
+        for (auto i=capacity; i > w; i--)
+            p.s.remove(int(i - 1));
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        for (int r=0; r < rounds; r++)
+            step(p);
+        
+        ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        ops += p.ops;
+        reallocs += p.reallocs;
+        
+        auto rate = double(p.reallocs) / p.ops;
+        if (rate > worst_rate) {
+            worst_rate = rate;
+            worst = w;
+        }
+    }
+    
+    std::printf("%-14s %-9s %7.1f ns/op %8.5f reallocs/op", policy, workload, ns / ops, double(reallocs) / ops);
+    
+    if (worst) std::printf("   worst window %5zu of %5zu: %.5f\n", worst, capacity, worst_rate);
+    else std::printf("\n");
+}
+
+/**
+ Benchmark a policy on a stack-like workload, that inserts and removes the same
+ element, a queue-like one, that inserts a new element and removes the oldest,
+ and a sawtooth, that inserts as many elements as the window and removes them.
+ @param name the name of the policy
+ */
+template <typename Growth>
+void bench(const char* name) {
+    run<Growth>(name, "stack", 2000, [](auto& p) {
+        auto t = int(p.s.size());
+        
+        p.insert(t);
+        p.remove(t);
+    });
+    
+    run<Growth>(name, "queue", 2000, [](auto& p) {
+        p.insert(p.s[int(p.s.size()) - 1] + 1);
+        p.remove(int(p.s[0]));
+    });
+    
+    run<Growth>(name, "sawtooth", 4, [](auto& p) {
+        auto w = int(p.s.size());
+        
+        for (int i=0; i < w; i++)
+            p.insert(w + i);
+        
+        for (int i=w-1; i >= 0; i--)
+            p.remove(w + i);
+    });
+}
+
+int main() {
+    bench<EagerShrink>("eager");
+    bench<GrowthPolicy<>>("default");
+    bench<GrowthPolicy<3, 2, 4>>("factor 1.5");
+    bench<GrowthPolicy<2, 1, 4, 4096>>("min 4096");
+    bench<NeverShrink>("never shrink");
+}
@@ -12,8 +12,25 @@
  */
 
 #include "Set.h"
+#include "StaticSet.h"
+#include "FrozenSet.h"
+#include "Roaring.h"
+#include "PersistentSet.h"
+#include "HyperLogLog.h"
+#include "WindowedSet.h"
+#include "CompactSet.h"
+#include "CuckooMap.h"
+#include "IngestQueue.h"
+#include "Execution.h"
 
 #include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <climits>
+#include <span>
+#include <atomic>
+#include <unordered_map>
 
 using namespace set;
 
@@ -110,7 +127,1091 @@ void test_set() {
     std::cout << "PASSED\n";
 }
 
+void test_small_set() {
+    Set<int, BloomFilter<int>, 4> s;
+    std::vector<int> l{1,2,3,4,5,6,7,8,9,10};
+    
+    std::cout << "Test insertion past the inline capacity: ";
+    for (auto e: l)
+        s.insert(e);
+    
+    assert(s.size() == l.size());
+    assert(std::equal(s.begin(), s.end(), l.begin()));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test insertion of already inserted element after spill: ";
+    auto error = false;
+    try {
+        s.insert(7);
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test deletion back to inline storage: ";
+    for (int i=1; i <= 9; i++)
+        s.remove(i);
+    
+    assert(s.size() == 1 && s[0] == 10);
+    s.insert(1);
+    
+    l = {10,1};
+    assert(std::equal(s.begin(), s.end(), l.begin()));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test move constructor of small set: ";
+    auto m = std::move(s);
+    
+    assert(std::equal(m.begin(), m.end(), l.begin()));
+    assert(s.size() == 0);
+    std::cout << "PASSED\n";
+}
+
+void test_adaptive_filter() {
+    using Adaptive = AdaptiveFilter<int, 32, 5, 64, BloomFilter<int, 64>>;
+    
+    std::cout << "Test adaptive filter switches to approx past threshold: ";
+    std::vector<int> l;
+    for (int i=0; i < 100; i++)
+        l.push_back(i);
+    
+    Adaptive a;
+    build(a, l.begin(), l.begin()+10);
+    assert(a.current() == Adaptive::Mode::NONE);
+    
+    build(a, l.begin(), l.end());
+    assert(a.current() == Adaptive::Mode::APPROX);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test adaptive filter switches to exact on false positives: ";
+    for (int i=100; i < 500 && !stale(a); i++) {
+        if (a.query(i) == Query::MAYBE)
+            l.push_back(i);
+        
+        a.add(i);
+    }
+    
+    assert(stale(a));
+    build(a, l.begin(), l.end());
+    assert(a.current() == Adaptive::Mode::EXACT);
+    assert(a.query(0) == Query::FOUND);
+    assert(a.query(-1) == Query::NOT_FOUND);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test set with adaptive filter: ";
+    Set<int, Adaptive, 4> s;
+    for (int i=0; i < 1000; i++)
+        s.insert(i);
+    
+    auto error = false;
+    try {
+        s.insert(500);
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error);
+    
+    for (int i=0; i < 1000; i += 2)
+        s.remove(i);
+    
+    assert(s.size() == 500 && s[0] == 1 && s[499] == 999);
+    std::cout << "PASSED\n";
+}
+
+void test_heterogeneous_lookup() {
+    std::vector<std::string> l{"if", "else", "while", "for", "return", "switch", "case"};
+    
+    std::cout << "Test contains with string_view: ";
+    Set<std::string, BloomFilter<std::string>, 4> s(l.begin(), l.end());
+    
+    assert(s.contains(std::string_view("while")));
+    assert(s.contains("case"));
+    assert(!s.contains(std::string_view("do")));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test contains with string_view in cuckoo table: ";
+    Set<std::string, CuckooTable<std::string>, 4> c(l.begin(), l.end());
+    
+    for (const auto& e: l)
+        assert(c.contains(std::string_view(e)));
+    
+    assert(!c.contains(std::string_view("do")));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test remove with string_view: ";
+    c.remove(std::string_view("for"));
+    
+    assert(!c.contains(std::string("for")));
+    assert(c.size() == l.size()-1);
+    std::cout << "PASSED\n";
+}
+
+struct Counted {
+    static int copies;
+    
+    int v = 0;
+    
+    Counted() =default;
+    Counted(int v_): v(v_) {}
+    Counted(const Counted& o): v(o.v) { copies++; }
+    Counted(Counted&& o) =default;
+    Counted& operator=(const Counted& o) { v = o.v; copies++; return *this; }
+    Counted& operator=(Counted&& o) =default;
+    
+    bool operator==(const Counted& o) const { return v == o.v; }
+};
+
+int Counted::copies = 0;
+
+void test_move_semantics() {
+    Set<Counted, BaseFilter<Counted>, 4> s;
+    
+    std::cout << "Test insertion by move and emplace don't copy: ";
+    for (int i=0; i < 10; i++) {
+        Counted c(i);
+        s.insert(std::move(c));
+    }
+    
+    s.emplace(10);
+    s.insert(Counted(11));
+    
+    assert(s.size() == 12 && s[11].v == 11);
+    assert(Counted::copies == 0);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test insertion by const reference copies once: ";
+    const Counted c(12);
+    s.insert(c);
+    
+    assert(Counted::copies == 1);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test move assignment: ";
+    Set<std::string, CuckooTable<std::string>, 4> a;
+    Set<std::string, CuckooTable<std::string>, 4> b;
+    for (int i=0; i < 20; i++)
+        a.insert(std::to_string(i));
+    
+    b.insert("x");
+    b = std::move(a);
+    
+    assert(b.size() == 20 && a.size() == 0);
+    assert(b.contains("7") && !b.contains("x"));
+    
+    auto error = false;
+    try {
+        b.insert("19");
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+}
+
+void test_static_set() {
+    static constexpr auto keywords = make_static_set<std::string_view>("if", "else", "while", "for",
+                                                                       "do", "return", "switch", "case",
+                                                                       "break", "continue", "goto");
+    
+    std::cout << "Test static set lookup at compile time: ";
+    static_assert(keywords.contains("while"), "");
+    static_assert(keywords.contains(std::string_view("goto")), "");
+    static_assert(!keywords.contains("until"), "");
+    static_assert(keywords.index_of("for") == 3, "");
+    static_assert(keywords[6] == "switch", "");
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test static set from braced list: ";
+    constexpr StaticSet ids({3, 1, 4, 15, 9, 2, 6, 5, 35, 8, 97, 93, 23, 84, 62, 64, 33, 83, 27, 950});
+    std::vector<int> l{3, 1, 4, 15, 9, 2, 6, 5, 35, 8, 97, 93, 23, 84, 62, 64, 33, 83, 27, 950};
+    
+    assert(std::equal(ids.begin(), ids.end(), l.begin()));
+    
+    for (int i=0; i < 1000; i++)
+        assert(ids.contains(i) == (std::find(l.begin(), l.end(), i) != l.end()));
+    
+    std::cout << "PASSED\n";
+}
+
+void test_frozen_set() {
+    Set<int, CuckooTable<int>> s;
+    for (int i=0; i < 50000; i++)
+        s.insert(i * 7);
+    
+    std::cout << "Test freeze keeps the order: ";
+    auto f = freeze(s, 4);
+    
+    assert(f.size() == s.size());
+    assert(std::equal(s.begin(), s.end(), f.begin()));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test frozen set lookup: ";
+    for (int i=0; i < 50000 * 7; i++) {
+        auto p = f.index_of(i);
+        
+        if (i % 7) assert(p == -1);
+        else assert(p == i / 7 && f.contains(i));
+    }
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test frozen set of strings: ";
+    std::vector<std::string> l{"if", "else", "while", "for", "return", "switch", "case"};
+    Set<std::string> w(l.begin(), l.end());
+    
+    auto fw = freeze(w);
+    
+    for (size_t i=0; i < l.size(); i++)
+        assert(fw.index_of(std::string_view(l[i])) == long(i));
+    
+    assert(!fw.contains("do"));
+    std::cout << "PASSED\n";
+}
+
+void test_roaring() {
+    std::vector<int> l;
+    for (int i=-70000; i < 200000; i++)
+        if (i % 3 || i > 150000)
+            l.push_back(i);
+    
+    std::cout << "Test roaring insertion and lookup: ";
+    Roaring<int> r(l.begin(), l.end());
+    
+    assert(r.size() == l.size());
+    assert(std::equal(r.begin(), r.end(), l.begin()));
+    assert(r.contains(-70000) && !r.contains(-69999) && r.contains(150001));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test roaring is smaller than the elements: ";
+    auto before = r.bytes();
+    r.optimize();
+    
+    assert(std::equal(r.begin(), r.end(), l.begin()));
+    assert(r.bytes() < before && r.bytes() * 10 < l.size() * sizeof(int));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test roaring union and intersection: ";
+    std::vector<int> m;
+    for (int i=0; i < 300000; i += 5)
+        m.push_back(i);
+    
+    Roaring<int> q(m.begin(), m.end());
+    std::vector<int> u, x;
+    
+    std::set_union(l.begin(), l.end(), m.begin(), m.end(), std::back_inserter(u));
+    std::set_intersection(l.begin(), l.end(), m.begin(), m.end(), std::back_inserter(x));
+    
+    auto ru = r | q;
+    auto rx = r & q;
+    
+    assert(ru.size() == u.size() && std::equal(ru.begin(), ru.end(), u.begin()));
+    assert(rx.size() == x.size() && std::equal(rx.begin(), rx.end(), x.begin()));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test roaring filter out: ";
+    auto f = filter_out(r, [](int x) { return x % 2 == 0; });
+    
+    assert(f.size() == std::count_if(l.begin(), l.end(), [](int x) { return x % 2 != 0; }));
+    for (auto e: f)
+        assert(e % 2 != 0);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test roaring remove: ";
+    for (int i=0; i < 150000; i++)
+        if (i % 3) r.remove(i);
+    
+    assert(!r.contains(1) && r.contains(-1) && r.contains(150001));
+    
+    auto error = false;
+    try {
+        r.remove(1);
+    } catch (exceptions::not_found) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test set with roaring filter keeps the order: ";
+    std::vector<uint32_t> ids{900000, 5, 70000, 6, 1 << 30};
+    Set<uint32_t, RoaringFilter<uint32_t>, 2> s(ids.begin(), ids.end());
+    
+    assert(std::equal(s.begin(), s.end(), ids.begin()));
+    assert(s.contains(70000u) && !s.contains(7u));
+    std::cout << "PASSED\n";
+}
+
+void test_batch() {
+    std::vector<int> l;
+    for (int i=0; i < 5000; i++)
+        l.push_back(i * 7 % 3000);
+    
+    std::cout << "Test insert many skips the duplicates: ";
+    Set<int, BloomFilter<int, 20000>> s;
+    s.insert(42);
+    
+    std::vector<uint64_t> mask((l.size()+63)/64);
+    auto inserted = s.insert_many(l.data(), l.size(), mask.data());
+    
+    assert(inserted == 2999 && s.size() == 3000);
+    assert(s[0] == 42 && s[1] == 0 && s[2] == 7);
+    assert(!(mask[0] >> 6 & 1) && (mask[0] & 1));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test contains many agrees with contains: ";
+    std::vector<int> q;
+    for (int i=-100; i < 4000; i++)
+        q.push_back(i);
+    
+    std::vector<uint64_t> found((q.size()+63)/64);
+    assert(s.contains_many(q.data(), q.size(), found.data()) == 3000);
+    
+    for (size_t i=0; i < q.size(); i++)
+        assert(bool(found[i / 64] >> (i % 64) & 1) == s.contains(q[i]));
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test batches with cuckoo filters and small sets: ";
+    Set<int, CuckooFilter<int, 2000>> c;
+    Set<int, CuckooTable<int, 8000>> t;
+    Set<int, BaseFilter<int>, 64> small;
+    
+    assert(c.insert_many(l.data(), l.size()) == 3000);
+    assert(t.insert_many(l.data(), l.size()) == 3000);
+    assert(small.insert_many(l.data(), 40) == 40 && small.size() == 40);
+    
+    assert(c.contains_many(q.data(), q.size(), found.data()) == 3000);
+    assert(t.contains_many(q.data(), q.size(), found.data()) == 3000);
+    assert(small.contains_many(q.data(), q.size(), found.data()) == 40);
+    
+    for (int i=0; i < 3000; i++)
+        assert(c.contains(i) && t.contains(i));
+    
+    std::cout << "PASSED\n";
+}
+
+void test_persistent_set() {
+    std::cout << "Test copy keeps the elements and the filter: ";
+    std::vector<int> l;
+    for (int i=0; i < 1000; i++)
+        l.push_back(i * 13);
+    
+    Set<int, AdaptiveFilter<int>> s(l.begin(), l.end());
+    assert(s.contains(13));
+    
+    Set<int, AdaptiveFilter<int>> c(s);
+    c.insert(1);
+    
+    assert(c.size() == 1001 && s.size() == 1000);
+    assert(std::equal(s.begin(), s.end(), c.begin()));
+    assert(c.contains(1) && !s.contains(1) && c.contains(13 * 999));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test snapshot doesn't see the mutations: ";
+    PersistentSet<int, BloomFilter<int, 20000>> p(l.begin(), l.end());
+    auto snap = p.snapshot();
+    
+    p.insert(1);
+    p.remove(13 * 999);
+    
+    assert(snap.size() == 1000 && p.size() == 1000);
+    assert(std::equal(snap.begin(), snap.end(), l.begin()));
+    assert(snap.contains(13 * 999) && !snap.contains(1));
+    assert(p.contains(1) && !p.contains(13 * 999) && p[999] == 1);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test mutations copy only the chunks they touch: ";
+    assert(p.shares(snap, 0) && p.shares(snap, 900));
+    assert(!p.shares(snap, 999));
+    
+    p.remove(0);
+    
+    assert(!p.shares(snap, 0) && p[0] == 13 && snap[0] == 0);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test insertion after a snapshot copies one shard of the filter: ";
+    std::vector<int> m;
+    for (int i=0; i < 100000; i++)
+        m.push_back(i * 7);
+    
+    PersistentSet<int, CuckooTable<int>> large(m.begin(), m.end());
+    auto before = large.snapshot();
+    large.insert(1);
+    
+    size_t shared = 0;
+    for (auto e: m)
+        shared += large.shares_filter(before, e);
+    
+    assert(!large.shares_filter(before, 1) && shared > m.size() * 9 / 10);
+    assert(large.shares(before, 0) && large.shares(before, 99935) && !large.shares(before, 99999));
+    assert(large.size() == 100001 && before.size() == 100000 && large[100000] == 1);
+    
+    for (int i=0; i < 100000; i += 7)
+        assert(large.contains(m[i]) && before.contains(m[i]) && !before.contains(1));
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test snapshot of an empty set: ";
+    PersistentSet<std::string> e;
+    auto empty = e.snapshot();
+    
+    e.insert("a");
+    e.insert("b");
+    
+    assert(empty.size() == 0 && !empty.contains("a") && e.size() == 2);
+    std::cout << "PASSED\n";
+}
+
+void test_merge() {
+    std::cout << "Test merge of sets built by different workers: ";
+    std::vector<Set<int, BloomFilter<int, 50000>>> workers(4);
+    
+    parallel_for(workers.size(), 4, [&](size_t b, size_t e, unsigned) {
+        for (auto w=b; w < e; w++)
+            for (int i=0; i < 2000; i++)
+                workers[w].insert(int(w) * 1000 + i);
+    });
+    
+    auto merged = std::move(workers[0]);
+    for (size_t w=1; w < workers.size(); w++)
+        assert(merged.merge(workers[w]) == 1000);
+    
+    assert(merged.size() == 5000 && merged.merge(workers[1]) == 0);
+    for (int i=0; i < 5000; i++)
+        assert(merged[i] == i && merged.contains(i));
+    
+    assert(!merged.contains(5000) && !merged.contains(-1));
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test merge of cuckoo filters and tables: ";
+    Set<int, CuckooFilter<int, 2000>> c1, c2;
+    Set<int, CuckooTable<int>> t1, t2;
+    
+    for (int i=0; i < 3000; i++) {
+        c1.insert(i);
+        t1.insert(i);
+        c2.insert(i + 1500);
+        t2.insert(i + 1500);
+    }
+    
+    assert(c1.merge(c2) == 1500 && t1.merge(t2) == 1500);
+    for (int i=0; i < 4500; i++)
+        assert(c1.contains(i) && t1.contains(i) && c1[i] == i && t1[i] == i);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test filters sent through a stream can be merged: ";
+    BloomFilter<int> a(7), b(7), received, other(8);
+    for (int i=0; i < 100; i++) {
+        a.add(i);
+        b.add(i + 100);
+    }
+    
+    std::stringstream pipe;
+    a.save(pipe);
+    received.load(pipe);
+    
+    b.merge(received);
+    for (int i=0; i < 200; i++)
+        assert(b.query(i) == Query::MAYBE);
+    
+    auto error = false;
+    try {
+        other.merge(received);
+    } catch (exceptions::incompatible) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test merged bloom counters saturate: ";
+    BloomFilter<int, 16> full(1), half(1);
+    for (int i=0; i < 1000; i++) {
+        full.add(i);
+        half.add(i + 1000);
+    }
+    
+    full.merge(half);
+    for (int i=0; i < 1000; i++)
+        full.remove(i);
+    
+    for (int i=1000; i < 2000; i++)
+        assert(full.query(i) == Query::MAYBE);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test cuckoo filters with the same seed are equal: ";
+    CuckooFilter<int, 50> f1(3), f2(3), f3;
+    std::stringstream s1, s2, s3;
+    
+    for (int i=0; i < 180; i++) {
+        f1.add(i);
+        f2.add(i);
+    }
+    
+    f1.save(s1);
+    f2.save(s2);
+    f3.load(s2);
+    f3.save(s3);
+    
+    assert(s1.str() == s2.str() && s1.str() == s3.str());
+    std::cout << "PASSED\n";
+}
+
+void test_estimate() {
+    std::vector<int> l;
+    for (int i=0; i < 300000; i++)
+        l.push_back(i * 7 % 100000);
+    
+    std::cout << "Test sketch estimates the distinct elements: ";
+    auto estimate = sketch(l.begin(), l.end()).estimate();
+    
+    assert(estimate > 95000 && estimate < 105000);
+    
+    HyperLogLog<int> small(l.begin(), l.begin() + 100);
+    assert(small.estimate() >= 98 && small.estimate() <= 102);
+    assert(HyperLogLog<int>().estimate() == 0);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test reserved filters keep a low false positive rate: ";
+    BloomFilter<int> bloom;
+    bloom.reserve(estimate);
+    
+    for (int i=0; i < 100000; i++)
+        bloom.add(i);
+    
+    int maybe = 0;
+    for (int i=100000; i < 200000; i++)
+        maybe += bloom.query(i) == Query::MAYBE;
+    
+    assert(maybe < 5000);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test set presized from the estimate: ";
+    Set<int, CuckooFilter<int>> s;
+    s.insert(-1);
+    s.reserve_for_estimated(estimate);
+    
+    for (int i=0; i < 100000; i++)
+        s.insert(i);
+    
+    assert(s.size() == 100001 && s.contains(-1) && s.contains(99999) && !s.contains(100000));
+    std::cout << "PASSED\n";
+}
+
+void test_parallel_build() {
+    std::vector<int> l;
+    for (int i=0; i < 200000; i++)
+        l.push_back(int(uint32_t(i) * 2654435761u % 60000));
+    
+    std::cout << "Test parallel build keeps the first occurrences in order: ";
+    Set<int, CuckooTable<int>> sequential(l.begin(), l.end());
+    
+    for (unsigned threads: {0u, 1u, 3u, 8u}) {
+        Set<int, CuckooTable<int>> s(parallel, l.begin(), l.end(), threads);
+        
+        assert(s.size() == sequential.size());
+        assert(std::equal(s.begin(), s.end(), sequential.begin()));
+    }
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test parallel build of strings and small ranges: ";
+    std::vector<std::string> words{"b", "a", "b", "c", "a", "d"};
+    Set<std::string, CuckooFilter<std::string>, 2> w(parallel, words.begin(), words.end(), 4);
+    
+    assert(w.size() == 4 && w[0] == "b" && w[1] == "a" && w[2] == "c" && w[3] == "d");
+    assert(w.contains(std::string("c")) && !w.contains(std::string("e")));
+    
+    Set<int> small(parallel, l.begin(), l.begin() + 3);
+    Set<int> empty(parallel, l.end(), l.end());
+    
+    assert(small.size() == 3 && small[2] == l[2] && empty.size() == 0);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test concurrent lookups on a const set: ";
+    const Set<int, CuckooTable<int>> shared(l.begin(), l.end());
+    std::atomic<size_t> found{0};
+    
+    parallel_for(120000, 4, [&](size_t b, size_t e, unsigned) {
+        uint64_t mask[1];
+    
+        for (auto i=b; i < e; i++) {
+            found += shared.contains(int(i));
+            found += shared.contains_many(&l[i], 1, mask);
+        }
+    });
+    
+    assert(found == 60000 + 120000);
+    std::cout << "PASSED\n";
+}
+
+struct FakeClock {
+    using duration   = std::chrono::seconds;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::time_point<FakeClock>;
+    
+    static constexpr bool is_steady = true;
+    static time_point current;
+    
+    static time_point now() {
+        return current;
+    }
+};
+
+FakeClock::time_point FakeClock::current;
+
+void test_windowed_set() {
+    std::cout << "Test window of the last elements: ";
+    WindowedSet<int, BloomFilter<int>, 3> w(size_t(100));
+    
+    for (int i=0; i < 300; i++)
+        assert(w.add(i));
+    
+    assert(w.size() == 300 && w.contains(0) && w.contains(150) && w.contains(299));
+    
+    assert(w.add(300));
+    assert(w.size() == 201 && !w.contains(0) && !w.contains(99) && w.contains(100));
+    assert(w.add(0) && !w.add(150) && w.size() == 202);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test insert throws inside the window: ";
+    auto error = false;
+    try {
+        w.insert(300);
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test large window finds every element: ";
+    WindowedSet<int, BloomFilter<int>, 2> large(size_t(10000));
+    
+    for (int i=0; i < 20000; i++)
+        assert(large.add(i));
+    
+    for (int i=0; i < 20000; i++)
+        assert(large.contains(i));
+    
+    assert(large.size() == 20000);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test window of the last minutes: ";
+    WindowedSet<std::string, CuckooFilter<std::string>, 4, FakeClock> t(std::chrono::minutes(1));
+    
+    t.insert("a");
+    FakeClock::current += std::chrono::seconds(90);
+    t.insert("b");
+    
+    assert(t.contains("a") && t.contains("b") && !t.add("a"));
+    
+    FakeClock::current += std::chrono::seconds(160);
+    assert(!t.contains("a") && t.contains("b") && t.size() == 1);
+    
+    FakeClock::current += std::chrono::minutes(10);
+    assert(!t.contains("b") && t.size() == 0 && t.add("a") && t.add("b"));
+    std::cout << "PASSED\n";
+
+    std::cout << "Test time window presized for the elements expected: ";
+    WindowedSet<int, BloomFilter<int>, 2, FakeClock> presized(std::chrono::minutes(1), 5000);
+
+    for (int i=0; i < 10000; i++) {
+        if (i == 5000) FakeClock::current += std::chrono::seconds(61);
+        assert(presized.add(i));
+    }
+
+    for (int i=0; i < 10000; i++)
+        assert(presized.contains(i) && !presized.contains(-1 - i));
+
+    FakeClock::current += std::chrono::seconds(61);
+    assert(presized.add(0) && !presized.contains(1) && presized.contains(9999));
+    std::cout << "PASSED\n";
+}
+
+void test_compact_set() {
+    std::vector<uint64_t> ids;
+    for (uint64_t i=0; i < 100000; i++)
+        ids.push_back(i * 2654435761u % (1 << 24) + (1 << 20));
+    
+    std::cout << "Test compact set keeps the order: ";
+    CompactSet<uint64_t> c(ids.begin(), ids.end());
+    
+    assert(c.size() == ids.size());
+    assert(std::equal(c.begin(), c.end(), ids.begin()));
+    
+    for (size_t i=0; i < ids.size(); i += 97)
+        assert(c[i] == ids[i]);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test compact set is smaller counting the filter: ";
+    RoaringFilter<uint64_t> exact;
+    build(exact, ids.begin(), ids.end());
+    
+    // the elements take less than half, with the same filter on both sides less than 60%
+    assert((c.bytes() - exact.bytes()) * 2 < ids.size() * sizeof(uint64_t));
+    assert(c.bytes() * 5 < (ids.size() * sizeof(uint64_t) + exact.bytes()) * 3);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test compact set lookup and duplicates: ";
+    assert(c.contains(ids[0]) && c.contains(ids[99999]) && !c.contains(uint64_t(1)));
+    
+    auto error = false;
+    try {
+        c.insert(ids[500]);
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test compact set of signed values: ";
+    std::vector<int> l;
+    for (int i=0; i < 1000; i++)
+        l.push_back(i % 2 ? -i : i * 1000);
+    
+    CompactSet<int, CuckooTable<int>> s(l.begin(), l.end());
+    CompactSet<int> one;
+    one.insert(INT_MIN);
+    one.insert(INT_MAX);
+    
+    assert(std::equal(s.begin(), s.end(), l.begin()) && s[999] == -999 && s.contains(-1) && !s.contains(1));
+    assert(one[0] == INT_MIN && one[1] == INT_MAX && one.size() == 2);
+
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test compact set finds every inserted element: ";
+    CompactSet<int> large;
+    for (int i=0; i < 200000; i++)
+        large.insert(i * 7 - 700000);
+    
+    for (int i=0; i < 200000; i++)
+        assert(large.contains(i * 7 - 700000) && !large.contains(i * 7 - 699999));
+    
+    error = false;
+    try {
+        large.insert(7);
+    } catch (exceptions::already_in) {
+        error = true;
+    }
+    
+    assert(error && large.size() == 200000);
+    std::cout << "PASSED\n";
+}
+
+void test_contiguous() {
+    using S = Set<int, CuckooTable<int>>;
+    
+    static_assert(std::contiguous_iterator<decltype(std::declval<const S&>().begin())>);
+    
+    std::vector<int> l;
+    for (int i=0; i < 50000; i++)
+        l.push_back(i * 7);
+    
+    S s(l.begin(), l.end());
+    
+    std::cout << "Test contiguous view of the elements: ";
+    std::span<const int> v = s;
+    
+    assert(v.size() == s.size() && v.data() == s.data() && s.data() == &s[0]);
+    assert(std::equal(s.view().begin(), s.view().end(), l.begin()));
+    
+    auto it = s.begin();
+    auto cit = 10 + it;
+    assert(cit - it == 10 && it < cit && *cit == 70 && it[3] == 21 && std::to_address(cit) == s.data() + 10);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test filter out with execution policies: ";
+    auto odd = [](int x) { return x % 2 != 0; };
+    auto f = filter_out(s, odd);
+    auto p = filter_out(std::execution::par, s, odd);
+    auto q = filter_out(std::execution::seq, s, odd);
+    
+    assert(p.size() == f.size() && std::equal(p.begin(), p.end(), f.begin()));
+    assert(q.size() == f.size() && std::equal(q.begin(), q.end(), f.begin()));
+    assert(p.contains(14) && !p.contains(7));
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test for each and transform reduce with execution policies: ";
+    auto sum = transform_reduce(std::execution::par, s, 0ll, std::plus<>(), [](int x) { return (long long) x; });
+    assert(sum == 7ll * 49999 * 50000 / 2);
+    
+    S empty;
+    assert(transform_reduce(std::execution::par_unseq, empty, 5, std::plus<>(), [](int x) { return x; }) == 5);
+    
+    std::atomic<int> count{0};
+    for_each(std::execution::par, s, [&](int x) { if (x % 3 == 0) count++; });
+    assert(count == 16667);
+    
+    std::cout << "PASSED\n";
+}
+
+void test_large_pages() {
+    utils::large_pages = 1;
+    
+    std::cout << "Test buffer keeps the elements when remapped: ";
+    utils::Buffer<int> b(1000);
+    for (int i=0; i < 1000; i++)
+        b[i] = i;
+    
+#ifdef __linux__
+    assert(b.mapped());
+#endif
+    
+    b.resize(3000000, 1000);
+    b[2999999] = -1;
+    
+    for (int i=0; i < 1000; i++)
+        assert(b[i] == i);
+    
+    b.resize(10, 10);
+    assert(b.size() == 10 && b[9] == 9);
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test sets and filters on large pages: ";
+    Set<int, CuckooTable<int>> s;
+    for (int i=0; i < 100000; i++)
+        s.insert(i * 3);
+    
+    for (int i=0; i < 100000; i += 50)
+        s.remove(i * 3);
+    
+    assert(s.size() == 98000 && s[0] == 3 && s.contains(299997) && !s.contains(0) && !s.contains(1));
+    
+    CuckooFilter<int> f;
+    f.reserve(50000);
+    for (int i=0; i < 50000; i++)
+        f.add(i);
+    
+    auto copy = f;
+    assert(copy.query(49999) == Query::MAYBE && f.query(123) == Query::MAYBE);
+    
+    Set<std::string> words;
+    words.insert("large");
+    words.insert("pages");
+    assert(words.contains(std::string("pages")));
+    
+    utils::large_pages = 0;
+    
+    std::cout << "PASSED\n";
+}
+
+void test_cuckoo_map() {
+    std::cout << "Test cuckoo map agrees with unordered_map: ";
+    CuckooMap<int, long> m;
+    std::unordered_map<int, long> reference;
+    std::minstd_rand random(7);
+    
+    for (int i=0; i < 60000; i++) {
+        int key = random() % 20000;
+        
+        if (random() % 3 == 0)
+            assert(m.erase(key) == (reference.erase(key) == 1));
+        else
+            assert(m.insert_or_assign(key, long(i)) == reference.insert_or_assign(key, long(i)).second);
+    }
+    
+    assert(m.size() == reference.size());
+    
+    for (int key=0; key < 20000; key++) {
+        auto v = m.find(key);
+        auto it = reference.find(key);
+        
+        assert((v != nullptr) == (it != reference.end()) && m.contains(key) == (v != nullptr));
+        if (v) assert(*v == it->second);
+    }
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test cuckoo map of strings: ";
+    CuckooMap<std::string, std::string, 4> attributes;
+    attributes.reserve(100);
+    
+    for (int i=0; i < 100; i++)
+        attributes.insert_or_assign(std::to_string(i), std::string(i % 7 + 20, 'x'));
+    
+    assert(!attributes.insert_or_assign("42", "answer"));
+    assert(*attributes.find(std::string_view("42")) == "answer");
+    assert(attributes.erase("42") && !attributes.erase("42") && !attributes.find("42"));
+    assert(attributes.size() == 99 && attributes.find(std::string("99"))->size() == 99 % 7 + 20);
+    
+    const auto& view = attributes;
+    assert(view.find("7") && !view.contains(std::string_view("100")));
+    
+    std::cout << "PASSED\n";
+}
+
+void test_growth_policy() {
+    std::cout << "Test no reallocation when oscillating around a threshold: ";
+    Set<int, CuckooTable<int>> s;
+    for (int i=0; i < 65; i++)
+        s.insert(i);
+    
+    auto data = s.data();
+    
+    for (int i=0; i < 1000; i++) {
+        s.remove(64);
+        s.insert(64);
+    }
+    
+    assert(s.data() == data && s.size() == 65);
+    
+    for (int i=64; i >= 20; i--)
+        s.remove(i);
+    
+    assert(s.data() != data && s.size() == 20 && s[19] == 19);
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test never shrink and minimum capacity: ";
+    Set<int, CuckooTable<int>, 16, hasher<int>, std::equal_to<>, NeverShrink> n;
+    for (int i=0; i < 1000; i++)
+        n.insert(i);
+    
+    data = n.data();
+    
+    for (int i=999; i >= 10; i--)
+        n.remove(i);
+    
+    assert(n.data() == data && n.size() == 10 && n.contains(9) && !n.contains(10));
+    
+    Set<int, CuckooTable<int>, 16, hasher<int>, std::equal_to<>, GrowthPolicy<3, 2, 4, 256>> m;
+    for (int i=0; i < 17; i++)
+        m.insert(i);
+    
+    data = m.data();
+    
+    for (int i=17; i < 256; i++)
+        m.insert(i);
+    
+    assert(m.data() == data && m.size() == 256);
+    
+    m.insert(256);
+    
+    auto f = filter_out(m, [](int x) { return x % 2 == 0; });
+    assert(f.size() == 128 && f[0] == 1);
+    
+    std::cout << "PASSED\n";
+}
+
+void test_ingest_queue() {
+    using S = Set<int, CuckooTable<int>>;
+    
+    std::cout << "Test ingest queue from many producers: ";
+    S s;
+    IngestQueue<int, S, 256> q(s);
+    
+    std::atomic<int> inserted{0};
+    std::atomic<unsigned> finished{0};
+    std::vector<std::thread> producers;
+    
+    for (unsigned t=0; t < 4; t++)
+        producers.emplace_back([&, t] {
+            for (int i=0; i < 20000; i++)
+                q.push(int(t * 5000 + i), [&](bool added) { if (added) inserted++; });
+            
+            finished++;
+        });
+    
+    while (finished < 4 || q.drain())
+        q.drain();
+    
+    for (auto& p: producers)
+        p.join();
+    
+    assert(s.size() == 35000 && inserted == 35000);
+    
+    for (int i=0; i < 35000; i++)
+        assert(s.contains(i));
+    
+    std::cout << "PASSED\n";
+    
+    std::cout << "Test ingest queue futures and full queue: ";
+    S t;
+    IngestQueue<int, S, 4> small(t);
+    
+    auto first = small.push(7);
+    auto again = small.push(7);
+    auto other = small.push(8);
+    
+    assert(small.try_push(9) && !small.try_push(10));
+    assert(small.drain() == 4 && small.drain() == 0);
+    assert(first.get() && !again.get() && other.get());
+    assert(t.size() == 3 && t[0] == 7 && t[2] == 9);
+    
+    std::cout << "PASSED\n";
+}
+
 int main(int argc, const char * argv[]) {
     std::cout << "======== SET TESTS ========" << std::endl;
     test_set();
+    
+    std::cout << "===== SMALL SET TESTS =====" << std::endl;
+    test_small_set();
+    
+    std::cout << "=== ADAPTIVE FILTER TESTS ===" << std::endl;
+    test_adaptive_filter();
+    
+    std::cout << "=== HETEROGENEOUS TESTS ===" << std::endl;
+    test_heterogeneous_lookup();
+    
+    std::cout << "===== MOVE SEMANTICS TESTS =====" << std::endl;
+    test_move_semantics();
+    
+    std::cout << "===== STATIC SET TESTS =====" << std::endl;
+    test_static_set();
+    
+    std::cout << "===== FROZEN SET TESTS =====" << std::endl;
+    test_frozen_set();
+    
+    std::cout << "===== ROARING TESTS =====" << std::endl;
+    test_roaring();
+    
+    std::cout << "===== BATCH TESTS =====" << std::endl;
+    test_batch();
+    
+    std::cout << "===== PERSISTENT SET TESTS =====" << std::endl;
+    test_persistent_set();
+    
+    std::cout << "===== MERGE TESTS =====" << std::endl;
+    test_merge();
+    
+    std::cout << "===== ESTIMATE TESTS =====" << std::endl;
+    test_estimate();
+    
+    std::cout << "===== PARALLEL BUILD TESTS =====" << std::endl;
+    test_parallel_build();
+    
+    std::cout << "===== WINDOWED SET TESTS =====" << std::endl;
+    test_windowed_set();
+    
+    std::cout << "===== COMPACT SET TESTS =====" << std::endl;
+    test_compact_set();
+    
+    std::cout << "===== CONTIGUOUS TESTS =====" << std::endl;
+    test_contiguous();
+    
+    std::cout << "===== LARGE PAGES TESTS =====" << std::endl;
+    test_large_pages();
+    
+    std::cout << "===== CUCKOO MAP TESTS =====" << std::endl;
+    test_cuckoo_map();
+    
+    std::cout << "===== GROWTH POLICY TESTS =====" << std::endl;
+    test_growth_policy();
+    
+    std::cout << "===== INGEST QUEUE TESTS =====" << std::endl;
+    test_ingest_queue();
 }